@@ -1,280 +1,403 @@
-/* Benjamin Schroeder
- *
- * Cmd.c
- *
- * The implementation of a structure designed to store linux commands. Adds
- * functions inorder to process and store a command in the form of its arguments.
- * Adds the ability to break down and execute a given command based on the broken
- * down arguments. Helper function are also included that allow for splitting
- * a command at an index providing a command containing that arguments left and
- * right of the indicated index, along with commands used to get the length of the
- * command and to search a command for certain specified symbols.
- */
-
-#include "Cmd.h"
-#include <string.h>
-#include <stdio.h>
-#include <stdlib.h>
-#include <unistd.h>
-#include <fcntl.h>
-#include <sys/types.h>
-#include <sys/stat.h>
-#include <sys/mman.h>
-#include <wait.h>
-
-/* Sets the length property in Cmd. */
-void setCmdLength(Cmd* cmd) {
-    int length = 0;
-
-    while (cmd->args[length] != NULL || cmd->symbols[length] != NULL)
-    {
-        length++;
-    }
-
-    cmd->length = length;
-}
-
-/* Parses the command string contained in cmd->line.
- * * Assumes all fields in cmd (except cmd->line) are initailized to zero.
- * * On return, all fields of cmd are appropriatly populated. */
-void parseCmd(Cmd* cmd) {
-    char* token;
-    int i=0;
-    strcpy(cmd->tokenLine, cmd->line);
-    strtok(cmd->tokenLine, "\n");
-    token = strtok(cmd->tokenLine, " ");
-    while (token != NULL) {
-        if (*token == '\n') {
-            cmd->args[i] = NULL;
-        } else if (*token == REDIRECT_OUT_OP || *token == REDIRECT_IN_OP
-                   || *token == PIPE_OP || *token == BG_OP) {
-            cmd->symbols[i] = token;
-            cmd->args[i] = NULL;
-        } else {
-            cmd->args[i] = token;
-        }
-        token = strtok(NULL, " ");
-        i++;
-    }
-    cmd->pid = -1;
-    cmd->args[i] = NULL;
-    cmd->left = NULL;
-    cmd->right = NULL;
-    setCmdLength(cmd);
-}
-
-/* Finds the index of the first occurance of symbol in cmd->symbols.
- * * Returns -1 if not found. */
-int findSymbol(Cmd* cmd, char symbol) {
-    for (int i = 0; i < MAX_ARGS; i++) {
-        if (cmd->symbols[i] && *cmd->symbols[i] == symbol) {
-            return i;
-        }
-    }
-    return -1;
-}
-
-/* Opposite of findSymbol, finds the last occurance of a symbol in cmd->symbols.
- * Returns -1 if not found.
- * Needed inorder to have a command execute from cmd->left to cmd->right. */
-int findSymbolReverse(Cmd* cmd, char symbol) {
-    for (int i = cmd->length; i >= 0; i--) {
-        if (cmd->symbols[i] && *cmd->symbols[i] == symbol) {
-            return i;
-        }
-    }
-    return -1;
-}
-
-/* Returns the index of the furthest cmd->right symbol in cmd->symbols
- * Returns -1 if there are no symbols that need to be dealt with. */
-int splitPoint(Cmd* cmd) {
-    int parse = -1;
-
-    //Symbols that are checked for
-    int insignal = findSymbolReverse(cmd, REDIRECT_IN_OP);
-    int outsignal = findSymbolReverse(cmd, REDIRECT_OUT_OP);
-    int pipesignal = findSymbolReverse(cmd, PIPE_OP);
-    int bgopsignal = findSymbolReverse(cmd, BG_OP);
-
-    //Checks to see which has the highest index
-    if (parse < insignal)
-        parse = insignal;
-
-    if (parse < outsignal)
-        parse = outsignal;
-
-    if (parse < pipesignal)
-        parse = pipesignal;
-
-    if (parse < bgopsignal)
-        parse = bgopsignal;
-
-    return parse;
-}
-
-/* Fills cmd->left & cmd->right by splitting at a provided index.
- * Some code is unneeded in the function as cmd will only ever be split
- * at the last for current usages, but wanted to leave functionality in
- * case a use was found. */
-void splitCMD(Cmd* cmd, int splitIndex) {
-    int i;
-
-    // if cmd already has a left and right declarations are frees
-    if (cmd->left != NULL)
-        free(cmd->left);
-    if (cmd->right != NULL)
-        free(cmd->right);
-
-    // left and right are allocated memory
-    cmd->left = (Cmd*) calloc(1, sizeof(Cmd));
-    cmd->right = (Cmd*) calloc(1, sizeof(Cmd));
-
-    // the args and symbols up to the split index are copied to left
-    for (i = 0; i < splitIndex; i++) {
-        cmd->left->args[i] = cmd->args[i];
-        cmd->left->symbols[i] = cmd->symbols[i];
-    }
-
-    // makes sure there is a NULL value following the args and symbols
-    cmd->left->args[i + 1] = NULL;
-    cmd->left->symbols[i + 1] = NULL;
-
-    // the args and symbols following the split index are copied to right
-    for (i = splitIndex + 1; i < cmd->length; i++) {
-        cmd->right->args[i - splitIndex - 1] = cmd->args[i];
-        cmd->right->symbols[i - splitIndex - 1] = cmd->symbols[i];
-    }
-
-    // makes sure the args and symbols are followed by a NULL value
-    cmd->right->args[i-splitIndex] = NULL;
-    cmd->right->symbols[i-splitIndex] = NULL;;
-
-    // runs setCmdLength for left and right
-    setCmdLength(cmd->left);
-    setCmdLength(cmd->right);
-}
-
-/* Executes a given Cmd a given input and output.
- * Returns exit code 2 if there is an execution error. */
-void exec(Cmd* cmd, int input, int output) {
-    // Set stdin if other input is desired
-    if (input != STDIN_FILENO) {
-        dup2(input, 0);
-    }
-
-    // Sets stdout if other output is desired
-    if (output != STDOUT_FILENO) {
-        dup2(output, 1);
-    }
-
-    // Executes cmd
-    execvp(cmd->args[0], cmd->args);
-
-    // Returns status 2 if there is an execution error
-    exit(10);
-}
-
-/* Recursive breaks down a given Cmd
- * Returns an exit status of 2 if there is an execution error. */
-void callCmd(Cmd* cmd, int input, int output) {
-    // Checks to see if there is an index of a symbol that requires the command to be processed.
-    int splitIndex = splitPoint(cmd);
-
-    if (splitIndex != -1)
-    {
-        //If there is a symbol call splitCmd to split the command at the index found
-        splitCMD(cmd, splitIndex);
-
-        //Gets the symbol that was found by split point
-        char symbol = cmd->symbols[splitIndex][0];
-
-        /* If a & is found the pid of left is set to the pid of command
-         * as the same thread will be dealing with the parsed code.
-         * Anything to the right of the symbol is ignored. */
-        if (symbol == BG_OP) {
-            cmd->left->pid = cmd->pid;
-            callCmd(cmd->left, input, output);
-        }
-
-        /* If a < is found the pid of left is set to the pid of command
-         * as the same thread will be dealing with the parsed code.
-         * The first argument to the right of the symbol is assumed to
-         * be a file name and is opened, and passed through to the
-         * recursive call. */
-        if (symbol == REDIRECT_IN_OP) {
-            cmd->left->pid = cmd->pid;
-            input = open(cmd->right->args[0], O_RDONLY);
-            callCmd(cmd->left, input, output);
-            // closes the file after execution
-            close(input);
-        }
-
-        /* If a > is found the pid of left is set to the pid of command
-         * as the same thread will be dealing with the parsed code.
-         * The first argument to the right of the symbol is assumed to
-         * be a file name and is opened, and passed through to the
-         * recursive call. */
-        if (symbol == REDIRECT_OUT_OP) {
-            cmd->left->pid = cmd->pid;
-            output = open(cmd->right->args[0], O_WRONLY|O_TRUNC|O_CREAT);
-            callCmd(cmd->left, input, output);
-            // closes the file after execution
-            close(output);
-        }
-
-        /* If the symbol is a |, a pipe is created. 2 new processes are then created
-         * with the left cmd outputting to the pipe, and the right receiving. The main
-         * process closes the pipe then waits for its children to be complete.
-         * Recursive piping should be possible moving left to right although I haven't
-         * tested it */
-        if (symbol == PIPE_OP){
-            // Creates and opens a pipe
-            int cmdpipe[2];
-
-            if (pipe(cmdpipe) == -1)
-            {
-                printf("Pipe Error\n");
-            }
-
-            // Forks for the left cmd
-            cmd->left->pid = fork();
-
-            if (cmd->left->pid == 0) {
-                close(cmdpipe[0]);
-                callCmd(cmd->left, input, cmdpipe[1]);
-            }
-
-            // Closes the input pipe
-            close(cmdpipe[1]);
-
-            // Forks for the right command
-            cmd->right->pid = fork();
-
-            if (cmd->right->pid == 0) {
-                callCmd(cmd->right, cmdpipe[0], output);
-            }
-
-            // Closes the output command
-            close(cmdpipe[0]);
-
-            // Main process waits for children to complete
-            int leftStatus = waitpid(cmd->left->pid, NULL, 0);
-            int rightStatus = waitpid(cmd->right->pid, NULL, 0);
-
-            // If either child exited due to an execution error, the parent also exits
-            if (leftStatus == 10 || rightStatus == 10)
-                exit(10);
-        }
-        // Frees memory reserved by left and right
-        free(cmd->right);
-        free(cmd->left);
-
-        cmd->right = NULL;
-        cmd->left = NULL;
-    }
-    else {
-        // If command does no need to be processed then it is executed
-        exec(cmd, input, output);
-    }
-}
\ No newline at end of file
+/* Benjamin Schroeder
+ *
+ * Cmd.c
+ *
+ * The implementation of a structure designed to store linux commands. Adds
+ * functions inorder to process and store a command in the form of its arguments.
+ * The command is parsed into a pipeline by the parser in a single pass, with
+ * everything belonging to the command held in an arena that is reset once the
+ * command is finished. Adds the ability to start every stage of the pipeline
+ * directly from the shell, waiting for all of them by recording the status of
+ * each stage as the reaper reports it.
+ */
+
+#define _GNU_SOURCE
+
+#include "Cmd.h"
+#include "launch.h"
+#include "pathCache.h"
+#include "builtins.h"
+#include "parser.h"
+#include "plan.h"
+#include "expand.h"
+#include "trace.h"
+#include "stats.h"
+#include <errno.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <wait.h>
+#include <time.h>
+#include <sys/syscall.h>
+
+/* Allocates an empty Cmd with an empty arena. */
+Cmd* newCmd() {
+    return (Cmd*) calloc(1, sizeof(Cmd));
+}
+
+/* Copies length bytes of line into the arena of cmd and parses it into
+ * cmd->pipeline, or copies the tree of the same line from the parse cache.
+ * Lines of any length and number of arguments are accepted, but they must
+ * hold a single pipeline rather than a list or compound command. Variables
+ * are expanded with the values they have now.
+ * Returns -1 if the line is malformed, leaving cmd->pipeline NULL. */
+int parseCmd(Cmd* cmd, const char* line, size_t length) {
+    uint64_t start = traceClock();
+
+    cmd->line = arenaCopy(&cmd->arena, line, length);
+    cmd->pid = -1;
+    cmd->stageCount = 0;
+    cmd->pipeline = NULL;
+
+    // A line seen before shares the plan in the cache instead of being parsed again
+    Plan* plan;
+    int result = loadPlan(cmd->line, length, &plan);
+
+    if (result == PLAN_INCOMPLETE) {
+        printf("Syntax error: unexpected end of line\n");
+    } else if (result == PLAN_COMPLETE) {
+        // Only a plan that just runs one pipeline, or nothing, can be held by a command
+        if (plan->count == 0) {
+            cmd->pipeline = (Pipeline*) arenaAlloc(&cmd->arena, sizeof(Pipeline));
+            memset(cmd->pipeline, 0, sizeof(Pipeline));
+        } else if (plan->count == 1 && plan->code[0].op == PLAN_RUN) {
+            cmd->pipeline = copyPipeline(plan->pipelines[0], arenaAlloc(&cmd->arena, plan->pipelines[0]->size));
+            if (cmd->pipeline->expand)
+                expandPipeline(cmd->pipeline, &cmd->arena);
+        } else {
+            printf("Syntax error: only a single pipeline can be run here\n");
+        }
+        releasePlan(plan);
+    }
+
+    traceSpan("parseCmd", start, "bytes", length);
+
+    return cmd->pipeline == NULL ? -1 : 0;
+}
+
+/* Copies pipeline, compiled ahead of time as part of a plan, into the arena
+ * of cmd along with the line it was parsed from, expanding its variables. */
+void loadPipeline(Cmd* cmd, const Pipeline* pipeline) {
+    cmd->line = arenaCopy(&cmd->arena, pipeline->line, strlen(pipeline->line));
+    cmd->pipeline = copyPipeline(pipeline, arenaAlloc(&cmd->arena, pipeline->size));
+    if (cmd->pipeline->expand)
+        expandPipeline(cmd->pipeline, &cmd->arena);
+    cmd->pid = -1;
+    cmd->stageCount = 0;
+}
+
+/* Closes the pidfds of every stage of cmd that are still open. */
+void closePidfds(Cmd* cmd) {
+    for (int i = 0; i < cmd->stageCount; i++) {
+        if (cmd->pidfds[i] != -1)
+            close(cmd->pidfds[i]);
+        cmd->pidfds[i] = -1;
+    }
+}
+
+/* Resets the arena of cmd so it can hold the next command. */
+void resetCmd(Cmd* cmd) {
+    closePidfds(cmd);
+    arenaReset(&cmd->arena);
+    cmd->line = NULL;
+    cmd->pipeline = NULL;
+    cmd->pids = NULL;
+    cmd->pidfds = NULL;
+    cmd->statuses = NULL;
+    cmd->usages = NULL;
+    cmd->finished = NULL;
+    cmd->stageCount = 0;
+}
+
+/* Releases a Cmd along with its arena. */
+void freeCmd(Cmd* cmd) {
+    closePidfds(cmd);
+    arenaFree(&cmd->arena);
+    free(cmd);
+}
+
+/* Appends length bytes of text to a growing buffer, keeping it NUL
+ * terminated. */
+void appendText(char** buffer, size_t* used, size_t* capacity, const char* text, size_t length) {
+    if (*used + length + 1 > *capacity) {
+        while (*used + length + 1 > *capacity)
+            *capacity = *capacity == 0 ? 256 : *capacity * 2;
+        *buffer = (char*) realloc(*buffer, *capacity);
+    }
+
+    memcpy(*buffer + *used, text, length);
+    *used += length;
+    (*buffer)[*used] = '\0';
+}
+
+/* Appends an argument followed by a space to a growing buffer, in single
+ * quotes so the parser reads it back as one word. A quote inside it is
+ * written as '\''. */
+void appendQuoted(char** buffer, size_t* used, size_t* capacity, const char* arg) {
+    appendText(buffer, used, capacity, "'", 1);
+    for (const char* quote; (quote = strchr(arg, '\'')) != NULL; arg = quote + 1) {
+        appendText(buffer, used, capacity, arg, quote - arg);
+        appendText(buffer, used, capacity, "'\\''", 4);
+    }
+    appendText(buffer, used, capacity, arg, strlen(arg));
+    appendText(buffer, used, capacity, "' ", 2);
+}
+
+/* Starts every stage of cmd directly from the calling process. All of the
+ * pipes connecting the stages are created before any stage is started, the
+ * first stage reads from input and the last writes to output. The pid of
+ * each stage is stored in cmd->pids and cmd->pid is set to the last one.
+ * A stage whose program cannot be found is given the exit status 127, one
+ * whose program cannot be executed 126 and one whose redirects cannot be
+ * carried out 1.
+ * Returns the number of stages or -1 if the pipes could not be created. */
+int startPipeline(Cmd* cmd, int input, int output) {
+    Stage* stages = cmd->pipeline->stages;
+    int count = cmd->pipeline->stageCount;
+
+    // The stage tables are sized to the pipeline
+    cmd->pids = (pid_t*) arenaAlloc(&cmd->arena, sizeof(pid_t) * count);
+    cmd->pidfds = (int*) arenaAlloc(&cmd->arena, sizeof(int) * count);
+    cmd->statuses = (int*) arenaAlloc(&cmd->arena, sizeof(int) * count);
+    cmd->usages = (struct rusage*) arenaAlloc(&cmd->arena, sizeof(struct rusage) * count);
+    cmd->finished = (struct timespec*) arenaAlloc(&cmd->arena, sizeof(struct timespec) * count);
+    memset(cmd->usages, 0, sizeof(struct rusage) * count);
+    clock_gettime(CLOCK_MONOTONIC, &cmd->started);
+
+    // Creates all the pipes, close on exec keeps each stage from holding the others open
+    int (*pipes)[2] = arenaAlloc(&cmd->arena, sizeof(int[2]) * count);
+    for (int i = 0; i < count - 1; i++) {
+        if (pipe2(pipes[i], O_CLOEXEC) == -1) {
+            printf("Pipe Error\n");
+            for (int j = 0; j < i; j++) {
+                close(pipes[j][0]);
+                close(pipes[j][1]);
+            }
+            return -1;
+        }
+    }
+    stats.pipes += count - 1;
+
+    // Starts each stage reading from the pipe before it and writing to the pipe after it
+    for (int i = 0; i < count; i++) {
+        int stageInput = i == 0 ? input : pipes[i - 1][0];
+        int stageOutput = i == count - 1 ? output : pipes[i][1];
+
+        // Builtins run in a copy of the shell, everything else is executed
+        uint64_t start = statsClock();
+        const Redirect* failed = NULL;
+        Builtin builtin = findBuiltin(stages[i].args[0]);
+        if (builtin != NULL) {
+            cmd->pids[i] = forkBuiltin(builtin, stages[i].args, stageInput, stageOutput, stages[i].redirects, stages[i].redirectCount);
+            stats.forks++;
+        } else {
+            cmd->pids[i] = launch(stages[i].args, stageInput, stageOutput, stages[i].redirects, stages[i].redirectCount, &failed);
+            stats.execs++;
+        }
+        recordLatency(&stats.launchTime, statsClock() - start);
+        cmd->statuses[i] = -1;
+        cmd->pidfds[i] = -1;
+
+        // posix_spawn returns once the child has executed, so the child's own events start there
+        traceSpan("spawn", start, "pid", cmd->pids[i]);
+        if (cmd->pids[i] > 0)
+            traceChild("exec", 'B', cmd->pids[i], traceClock());
+
+        // The stage has not been reaped yet so its pid still refers to it
+        if (cmd->pids[i] > 0)
+            cmd->pidfds[i] = (int) syscall(SYS_pidfd_open, cmd->pids[i], 0);
+
+        if (cmd->pids[i] == -1) {
+            stats.execFailures++;
+            int error = errno;
+            if (failed != NULL) {
+                printRedirectError(failed);
+                cmd->statuses[i] = 1 << 8;
+            } else if (error == ENOENT && pathCacheLookup(stages[i].args[0]) == NULL) {
+                printf("%s: command not found\n", stages[i].args[0]);
+                cmd->statuses[i] = 127 << 8;
+            } else {
+                fprintf(stderr, "%s: %s\n", stages[i].args[0], strerror(error));
+                cmd->statuses[i] = 126 << 8;
+            }
+            cmd->finished[i] = cmd->started;
+        }
+    }
+
+    // The shell keeps none of the pipes open
+    for (int i = 0; i < count - 1; i++) {
+        close(pipes[i][0]);
+        close(pipes[i][1]);
+    }
+
+    cmd->stageCount = count;
+    cmd->pid = cmd->pids[count - 1];
+
+    return count;
+}
+
+/* Records a status change reported by the reaper on the stage of cmd it
+ * belongs to, along with the resources used by a stage that exited. A
+ * stopped stage is marked with -2 until it is continued.
+ * Returns 1 if the event belongs to cmd, otherwise 0. */
+int recordStatus(Cmd* cmd, const ChildEvent* event) {
+    int status = event->status;
+
+    for (int i = 0; i < cmd->stageCount; i++) {
+        if (cmd->pids[i] != event->pid || cmd->statuses[i] >= 0)
+            continue;
+
+        if (WIFSTOPPED(status)) {
+            cmd->statuses[i] = -2;
+        } else if (WIFCONTINUED(status)) {
+            cmd->statuses[i] = -1;
+        } else {
+            cmd->statuses[i] = status;
+            cmd->usages[i] = event->usage;
+            cmd->finished[i] = event->time;
+            traceChild("exec", 'E', event->pid, traceTime(event->time));
+
+            // The pidfd is no longer needed once the stage has exited
+            if (cmd->pidfds[i] != -1)
+                close(cmd->pidfds[i]);
+            cmd->pidfds[i] = -1;
+
+            // The command has finished once its last running stage exits
+            if (runningStages(cmd) == 0)
+                recordLatency(&stats.commandTime, traceTime(event->time) - traceTime(cmd->started));
+        }
+
+        return 1;
+    }
+
+    return 0;
+}
+
+/* Returns the number of stages of cmd that have not finished. */
+int runningStages(Cmd* cmd) {
+    int running = 0;
+
+    for (int i = 0; i < cmd->stageCount; i++) {
+        if (cmd->statuses[i] < 0)
+            running++;
+    }
+
+    return running;
+}
+
+/* Returns the number of stages of cmd that are stopped. */
+int stoppedStages(Cmd* cmd) {
+    int stopped = 0;
+
+    for (int i = 0; i < cmd->stageCount; i++) {
+        if (cmd->statuses[i] == -2)
+            stopped++;
+    }
+
+    return stopped;
+}
+
+/* Sends a signal to every stage of cmd that has not finished, through its
+ * pidfd when it has one. */
+void signalPipeline(Cmd* cmd, int signal) {
+    for (int i = 0; i < cmd->stageCount; i++) {
+        if (cmd->statuses[i] >= 0)
+            continue;
+
+        // Without a pidfd the signal is sent to the pid as before
+        if (cmd->pidfds[i] != -1)
+            syscall(SYS_pidfd_send_signal, cmd->pidfds[i], signal, NULL, 0);
+        else
+            kill(cmd->pids[i], signal);
+    }
+}
+
+/* Returns the exit status the shell gives for a wait status, 128 plus
+ * the signal for a process killed by a signal. */
+int exitCode(int status) {
+    return WIFSIGNALED(status) ? 128 + WTERMSIG(status) : WEXITSTATUS(status);
+}
+
+/* Returns the seconds from start to end. */
+double secondsBetween(struct timespec start, struct timespec end) {
+    return (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+}
+
+/* Returns the seconds held by a timeval of rusage. */
+double seconds(struct timeval time) {
+    return time.tv_sec + time.tv_usec / 1e6;
+}
+
+/* Prints a line for every stage of cmd to out giving its process id and
+ * state, followed for a stage that exited by its real, user and system
+ * time, peak memory and voluntary and involuntary context switches. */
+void printStageUsage(Cmd* cmd, FILE* out) {
+    for (int i = 0; i < cmd->stageCount; i++) {
+        int status = cmd->statuses[i];
+        char state[32];
+
+        if (status == -1)
+            snprintf(state, sizeof(state), "Running");
+        else if (status == -2)
+            snprintf(state, sizeof(state), "Stopped");
+        else if (WIFSIGNALED(status))
+            snprintf(state, sizeof(state), "Signal %d", WTERMSIG(status));
+        else if (WEXITSTATUS(status) != 0)
+            snprintf(state, sizeof(state), "Exit %d", WEXITSTATUS(status));
+        else
+            snprintf(state, sizeof(state), "Done");
+
+        fprintf(out, "    %d\t%-10s", cmd->pids[i], state);
+
+        // The resources of a stage are only known once it has exited
+        if (status >= 0) {
+            struct rusage* usage = &cmd->usages[i];
+            fprintf(out, " real %.3fs user %.3fs sys %.3fs maxrss %ldKB ctxsw %ld/%ld",
+                    secondsBetween(cmd->started, cmd->finished[i]), seconds(usage->ru_utime),
+                    seconds(usage->ru_stime), usage->ru_maxrss, usage->ru_nvcsw, usage->ru_nivcsw);
+        }
+
+        fprintf(out, "\t%s\n", cmd->pipeline->stages[i].args[0]);
+    }
+}
+
+/* Prints the real, user and system time of every stage of cmd added
+ * together to stderr, followed by the usage of each stage of a pipeline. */
+void printTime(Cmd* cmd) {
+    double real = 0;
+    double user = 0;
+    double system = 0;
+
+    // The pipeline ends when its last stage to exit does
+    for (int i = 0; i < cmd->stageCount; i++) {
+        double stageReal = secondsBetween(cmd->started, cmd->finished[i]);
+        if (stageReal > real)
+            real = stageReal;
+        user += seconds(cmd->usages[i].ru_utime);
+        system += seconds(cmd->usages[i].ru_stime);
+    }
+
+    fflush(stdout);
+    fprintf(stderr, "\nreal\t%dm%.3fs\n", (int) real / 60, real - (int) real / 60 * 60);
+    fprintf(stderr, "user\t%dm%.3fs\n", (int) user / 60, user - (int) user / 60 * 60);
+    fprintf(stderr, "sys\t%dm%.3fs\n", (int) system / 60, system - (int) system / 60 * 60);
+
+    if (cmd->stageCount > 1)
+        printStageUsage(cmd, stderr);
+}
+
+/* Prints the exit status of every stage of cmd in the same form as
+ * PIPESTATUS, a stage killed by a signal is shown as 128 plus the signal.
+ * Nothing is printed for a command with a single stage. */
+void printPipeStatus(Cmd* cmd) {
+    if (cmd->stageCount < 2)
+        return;
+
+    printf("PIPESTATUS:");
+    for (int i = 0; i < cmd->stageCount; i++) {
+        printf(" %d", exitCode(cmd->statuses[i]));
+    }
+    printf("\n");
+}
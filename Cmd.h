@@ -1,75 +1,129 @@
-/* Benjamin Schroeder
- *
- * Cmd.c
- *
- * The header file for a structure designed to store linux commands. Adds
- * functions inorder to process and store a command in the form of its arguments.
- * Adds the ability to break down and execute a given command based on the broken
- * down arguments. Helper function are also included that allow for splitting
- * a command at an index providing a command containing that arguments left and
- * right of the indicated index, along with commands used to get the length of the
- * command and to search a command for certain specified symbols.
- */
-
-#ifndef CS352P1_CMD_H
-#define CS352P1_CMD_H
-
-#include "shellVariables.h"
-#include <signal.h>
-
-/* Holds a single command. */
-typedef struct Cmd {
-    /* The command as input by the user. */
-    char line[MAX_LINE + 1];
-    /* The command as null terminated tokens. */
-    char tokenLine[MAX_LINE + 1];
-    /* Pointers to each argument in tokenLine, non-arguments are NULL. */
-    char *args[MAX_ARGS];
-    /* Pointers to each symbol in tokenLine, non-symbols are NULL. */
-    char *symbols[MAX_ARGS];
-    /* The process id of the executing command. */
-    pid_t pid;
-    /* How many arguments a command has including ending NULL value. */
-    int length;
-    /* Used to create a tree of arguments in callCmd */
-    struct Cmd *left;
-    struct Cmd *right;
-} Cmd;
-
-/* Sets the length property in Cmd. */
-void setCmdLength(Cmd* cmd);
-
-/* Parses the command string contained in cmd->line.
- * * Assumes all fields in cmd (except cmd->line) are initailized to zero.
- * * On return, all fields of cmd are appropriatly populated. */
-void parseCmd(Cmd* cmd);
-
-/* Finds the index of the first occurance of symbol in cmd->symbols.
- * * Returns -1 if not found. */
-int findSymbol(Cmd* cmd, char symbol);
-
-/* Opposite of findSymbol, finds the last occurance of a symbol in cmd->symbols.
- * Returns -1 if not found.
- * Needed inorder to have a command execute from cmd->left to cmd->right. */
-int findSymbolReverse(Cmd* cmd, char symbol);
-
-/* Returns the index of the furthest cmd->right symbol in cmd->symbols
- * Returns -1 if there are no symbols that need to be dealt with. */
-int parsePoint(Cmd* cmd);
-
-/* Fills cmd->left & cmd->right by splitting at a provided index.
- * Some code is unneeded in the function as cmd will only ever be split
- * at the last for current usages, but wanted to leave functionality in
- * case a use was found. */
-void parseCMD(Cmd* cmd, Cmd* left, Cmd* right, int parsePoint);
-
-/* Executes a given Cmd a given input and output.
- * Returns exit code 2 if there is an execution error. */
-void exec(Cmd* cmd, int input, int output);
-
-/* Recursive breaks down a given Cmd
- * Returns an exit status of 2 if there is an execution error. */
-void callCmd(Cmd* cmd, int input, int output);
-
-
+/* Benjamin Schroeder
+ *
+ * Cmd.c
+ *
+ * The header file for a structure designed to store linux commands. Adds
+ * functions inorder to process and store a command in the form of its arguments.
+ * The command is parsed into a pipeline by the parser in a single pass, with
+ * everything belonging to the command held in an arena that is reset once the
+ * command is finished. Adds the ability to start every stage of the pipeline
+ * directly from the shell, waiting for all of them by recording the status of
+ * each stage as the reaper reports it.
+ */
+
+#ifndef CS352P1_CMD_H
+#define CS352P1_CMD_H
+
+#include "shellVariables.h"
+#include "parser.h"
+#include "arena.h"
+#include "reaper.h"
+#include <stddef.h>
+#include <signal.h>
+#include <stdio.h>
+#include <time.h>
+#include <sys/resource.h>
+
+/* Holds a single command. */
+typedef struct Cmd {
+    /* Holds the line, parse tree and stage tables of the command. */
+    Arena arena;
+    /* The command as input by the user. */
+    char *line;
+    /* The parse tree of the command. */
+    Pipeline *pipeline;
+    /* The process id of the executing command. */
+    pid_t pid;
+    /* The process id of each stage of the pipeline. */
+    pid_t *pids;
+    /* A pidfd for each stage that is still running, or -1 if none could be
+     * opened. A pidfd always refers to the stage even once its pid is reused. */
+    int *pidfds;
+    /* The wait status of each stage, -1 while running and -2 while stopped. */
+    int *statuses;
+    /* How many stages the pipeline has. */
+    int stageCount;
+    /* When the pipeline was started, from the monotonic clock. */
+    struct timespec started;
+    /* The resources used by each stage and when it was reaped, filled in
+     * once the stage has exited. */
+    struct rusage *usages;
+    struct timespec *finished;
+} Cmd;
+
+/* Allocates an empty Cmd with an empty arena. */
+Cmd* newCmd();
+
+/* Copies length bytes of line into the arena of cmd and parses it into
+ * cmd->pipeline, or copies the tree of the same line from the parse cache.
+ * Lines of any length and number of arguments are accepted, but they must
+ * hold a single pipeline rather than a list or compound command. Variables
+ * are expanded with the values they have now.
+ * Returns -1 if the line is malformed, leaving cmd->pipeline NULL. */
+int parseCmd(Cmd* cmd, const char* line, size_t length);
+
+/* Copies pipeline, compiled ahead of time as part of a plan, into the arena
+ * of cmd along with the line it was parsed from, expanding its variables. */
+void loadPipeline(Cmd* cmd, const Pipeline* pipeline);
+
+/* Resets the arena of cmd so it can hold the next command. */
+void resetCmd(Cmd* cmd);
+
+/* Releases a Cmd along with its arena. */
+void freeCmd(Cmd* cmd);
+
+/* Appends length bytes of text to a growing buffer, keeping it NUL
+ * terminated. */
+void appendText(char** buffer, size_t* used, size_t* capacity, const char* text, size_t length);
+
+/* Appends an argument followed by a space to a growing buffer, in single
+ * quotes so the parser reads it back as one word. A quote inside it is
+ * written as '\''. */
+void appendQuoted(char** buffer, size_t* used, size_t* capacity, const char* arg);
+
+/* Starts every stage of cmd directly from the calling process. All of the
+ * pipes connecting the stages are created before any stage is started, the
+ * first stage reads from input and the last writes to output. The pid of
+ * each stage is stored in cmd->pids and cmd->pid is set to the last one.
+ * A stage whose program cannot be found is given the exit status 127, one
+ * whose program cannot be executed 126 and one whose redirects cannot be
+ * carried out 1.
+ * Returns the number of stages or -1 if the pipes could not be created. */
+int startPipeline(Cmd* cmd, int input, int output);
+
+/* Records a status change reported by the reaper on the stage of cmd it
+ * belongs to, along with the resources used by a stage that exited. A
+ * stopped stage is marked with -2 until it is continued.
+ * Returns 1 if the event belongs to cmd, otherwise 0. */
+int recordStatus(Cmd* cmd, const ChildEvent* event);
+
+/* Returns the number of stages of cmd that have not finished. */
+int runningStages(Cmd* cmd);
+
+/* Returns the number of stages of cmd that are stopped. */
+int stoppedStages(Cmd* cmd);
+
+/* Sends a signal to every stage of cmd that has not finished, through its
+ * pidfd when it has one. */
+void signalPipeline(Cmd* cmd, int signal);
+
+/* Prints a line for every stage of cmd to out giving its process id and
+ * state, followed for a stage that exited by its real, user and system
+ * time, peak memory and voluntary and involuntary context switches. */
+void printStageUsage(Cmd* cmd, FILE* out);
+
+/* Prints the real, user and system time of every stage of cmd added
+ * together to stderr, followed by the usage of each stage of a pipeline. */
+void printTime(Cmd* cmd);
+
+/* Returns the exit status the shell gives for a wait status, 128 plus
+ * the signal for a process killed by a signal. */
+int exitCode(int status);
+
+/* Prints the exit status of every stage of cmd in the same form as
+ * PIPESTATUS, a stage killed by a signal is shown as 128 plus the signal.
+ * Nothing is printed for a command with a single stage. */
+void printPipeStatus(Cmd* cmd);
+
+
 #endif //CS352P1_CMD_H
\ No newline at end of file
@@ -0,0 +1,107 @@
+/* Benjamin Schroeder
+ *
+ * arena.c
+ *
+ * The implementation of a bump allocator used to hold everything belonging to
+ * a single command. Memory is handed out from large blocks by moving a
+ * pointer forward, and is released all at once by resetting the arena after
+ * the command is finished with. A new block is only added when a command
+ * needs more memory than the arena holds, so the memory used grows with the
+ * size of the command rather than a fixed worst case.
+ */
+
+#include "arena.h"
+#include "shellVariables.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Every allocation is rounded up to keep the next one aligned for any type
+#define ARENA_ALIGN _Alignof(max_align_t)
+
+/* Returns size bytes of uninitialized memory from the arena, aligned for
+ * any type. A new block is added if the current one is full. */
+void* arenaAlloc(Arena* arena, size_t size) {
+    size = (size + ARENA_ALIGN - 1) & ~(size_t) (ARENA_ALIGN - 1);
+
+    ArenaBlock* block = arena->blocks;
+
+    if (block == NULL || block->size - block->used < size) {
+        // Large requests get a block of their own size
+        size_t blockSize = size > ARENA_BLOCK_SIZE ? size : ARENA_BLOCK_SIZE;
+
+        block = (ArenaBlock*) malloc(sizeof(ArenaBlock) + blockSize);
+        block->size = blockSize;
+        block->used = 0;
+        block->next = arena->blocks;
+        arena->blocks = block;
+    }
+
+    void* memory = block->data + block->used;
+    block->used += size;
+
+    return memory;
+}
+
+/* Copies length bytes of string into the arena followed by a terminator.
+ * Returns the copy. */
+char* arenaCopy(Arena* arena, const char* string, size_t length) {
+    char* copy = (char*) arenaAlloc(arena, length + 1);
+
+    memcpy(copy, string, length);
+    copy[length] = '\0';
+
+    return copy;
+}
+
+/* Resizes the most recent allocation of the arena, at memory with used
+ * bytes in use, to size bytes. It is resized in place when its block has
+ * room, otherwise it is moved to a new block along with its used bytes.
+ * Returns where the allocation now is. */
+void* arenaResize(Arena* arena, void* memory, size_t used, size_t size) {
+    ArenaBlock* block = arena->blocks;
+    size_t start = (char*) memory - block->data;
+
+    // The allocation is the last in the newest block so nothing after it is disturbed
+    if (start + size <= block->size) {
+        block->used = start + ((size + ARENA_ALIGN - 1) & ~(size_t) (ARENA_ALIGN - 1));
+        return memory;
+    }
+
+    void* moved = arenaAlloc(arena, size);
+    memcpy(moved, memory, used);
+    return moved;
+}
+
+/* Releases everything handed out by the arena. The first block is kept
+ * for the next command if it is of the default size, the rest are freed so
+ * a single large command does not hold onto its memory. */
+void arenaReset(Arena* arena) {
+    ArenaBlock* block = arena->blocks;
+
+    if (block == NULL)
+        return;
+
+    // The oldest block is the last in the list
+    while (block->next != NULL) {
+        ArenaBlock* next = block->next;
+        free(block);
+        block = next;
+    }
+
+    if (block->size == ARENA_BLOCK_SIZE) {
+        block->used = 0;
+        arena->blocks = block;
+    } else {
+        free(block);
+        arena->blocks = NULL;
+    }
+}
+
+/* Frees every block of the arena. */
+void arenaFree(Arena* arena) {
+    while (arena->blocks != NULL) {
+        ArenaBlock* next = arena->blocks->next;
+        free(arena->blocks);
+        arena->blocks = next;
+    }
+}
@@ -0,0 +1,56 @@
+/* Benjamin Schroeder
+ *
+ * arena.h
+ *
+ * The header file for a bump allocator used to hold everything belonging to
+ * a single command. Memory is handed out from large blocks by moving a
+ * pointer forward, and is released all at once by resetting the arena after
+ * the command is finished with. A new block is only added when a command
+ * needs more memory than the arena holds, so the memory used grows with the
+ * size of the command rather than a fixed worst case.
+ */
+
+#ifndef CS352P1_ARENA_H
+#define CS352P1_ARENA_H
+
+#include <stddef.h>
+
+/* A block of memory owned by an arena. */
+typedef struct ArenaBlock {
+    /* The block that was in use before this one. */
+    struct ArenaBlock *next;
+    /* How many bytes the block holds and how many have been handed out. */
+    size_t size;
+    size_t used;
+    /* The memory of the block, starting at an offset aligned for any type. */
+    _Alignas(max_align_t) char data[];
+} ArenaBlock;
+
+/* Holds the blocks of an arena, newest first. */
+typedef struct Arena {
+    ArenaBlock *blocks;
+} Arena;
+
+/* Returns size bytes of uninitialized memory from the arena, aligned for
+ * any type. A new block is added if the current one is full. */
+void* arenaAlloc(Arena* arena, size_t size);
+
+/* Copies length bytes of string into the arena followed by a terminator.
+ * Returns the copy. */
+char* arenaCopy(Arena* arena, const char* string, size_t length);
+
+/* Resizes the most recent allocation of the arena, at memory with used
+ * bytes in use, to size bytes. It is resized in place when its block has
+ * room, otherwise it is moved to a new block along with its used bytes.
+ * Returns where the allocation now is. */
+void* arenaResize(Arena* arena, void* memory, size_t used, size_t size);
+
+/* Releases everything handed out by the arena. The first block is kept
+ * for the next command if it is of the default size, the rest are freed so
+ * a single large command does not hold onto its memory. */
+void arenaReset(Arena* arena);
+
+/* Frees every block of the arena. */
+void arenaFree(Arena* arena);
+
+#endif //CS352P1_ARENA_H
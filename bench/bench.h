@@ -0,0 +1,21 @@
+/* Benjamin Schroeder
+ *
+ * bench.h
+ *
+ * The clock shared by the benchmarks. Every benchmark times itself with the
+ * monotonic clock, read here so they all measure in the same unit.
+ */
+
+#ifndef CS352P1_BENCH_H
+#define CS352P1_BENCH_H
+
+#include <time.h>
+
+/* Returns the current time of the monotonic clock in microseconds. */
+static inline double now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+#endif //CS352P1_BENCH_H
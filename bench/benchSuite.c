@@ -0,0 +1,226 @@
+/* Benjamin Schroeder
+ *
+ * benchSuite.c
+ *
+ * The benchmark suite run by 'make bench'. Measures the commands run per
+ * second by a script of 'true' lines, both as a builtin and as a program,
+ * and by two nested for loops running the builtin 'true' or 'x=$(echo $j)'
+ * as often, the time an N stage cat pipeline takes to move 1 GB, the time
+ * taken to parse long lines, both directly and through the parse cache, and
+ * the cost of reaping 1,000 and 10,000 background jobs. The shell is run as a
+ * separate process for the script and pipeline benchmarks, the rest call
+ * the shell's modules directly. Results are printed as a single JSON object
+ * so they can be compared across versions.
+ *
+ * Usage: benchSuite [shell] [stages] [megabytes]
+ */
+
+#include "../processList.h"
+#include "../reaper.h"
+#include "../parser.h"
+#include "../vars.h"
+#include "bench.h"
+#include <fcntl.h>
+#include <signal.h>
+#include <spawn.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <wait.h>
+
+extern char **environ;
+
+/* Runs the shell with the given arguments, discarding its output.
+ * Returns the seconds it took or -1 if it failed. */
+double runShell(const char* shell, char* first, char* second) {
+    char* args[] = {(char*) shell, first, second, NULL};
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_addopen(&actions, STDOUT_FILENO, "/dev/null", O_WRONLY, 0);
+
+    double start = now();
+    pid_t pid;
+    int status;
+    int error = posix_spawn(&pid, shell, &actions, NULL, args, environ);
+    posix_spawn_file_actions_destroy(&actions);
+
+    if (error != 0 || waitpid(pid, &status, 0) == -1 || !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+        return -1;
+    return (now() - start) / 1e6;
+}
+
+/* Writes a script of count lines of the given command and runs it.
+ * Prints the commands per second as a JSON member. */
+void benchScript(FILE* results, const char* shell, const char* name, const char* command, int count) {
+    char path[] = "/tmp/benchSuiteXXXXXX";
+    int file = mkstemp(path);
+    FILE* script = fdopen(file, "w");
+    for (int i = 0; i < count; i++)
+        fprintf(script, "%s\n", command);
+    fclose(script);
+
+    double seconds = runShell(shell, path, NULL);
+    unlink(path);
+
+    fprintf(results, "  \"%s\": {\"commands\": %d, \"seconds\": %.6f, \"commands_per_second\": %.1f},\n",
+            name, count, seconds, seconds > 0 ? count / seconds : 0);
+}
+
+/* Writes a script running the given command count times from two nested for
+ * loops of 1000 and count / 1000 passes, so it is parsed once rather than
+ * once a line. Prints the commands per second as a JSON member. */
+void benchLoop(FILE* results, const char* shell, const char* name, const char* command, int count) {
+    char path[] = "/tmp/benchSuiteXXXXXX";
+    int file = mkstemp(path);
+    FILE* script = fdopen(file, "w");
+    fprintf(script, "for i in");
+    for (int i = 0; i < count / 1000; i++)
+        fprintf(script, " %d", i);
+    fprintf(script, "\ndo\n    for j in");
+    for (int i = 0; i < 1000; i++)
+        fprintf(script, " %d", i);
+    fprintf(script, "\n    do\n        %s\n    done\ndone\n", command);
+    fclose(script);
+    count = count / 1000 * 1000;
+
+    double seconds = runShell(shell, path, NULL);
+    unlink(path);
+
+    fprintf(results, "  \"%s\": {\"commands\": %d, \"seconds\": %.6f, \"commands_per_second\": %.1f},\n",
+            name, count, seconds, seconds > 0 ? count / seconds : 0);
+}
+
+/* Runs head | cat | ... | cat moving the given number of megabytes through
+ * stages cats. Prints the time taken and throughput as a JSON member. */
+void benchPipeline(FILE* results, const char* shell, int stages, int megabytes) {
+    char line[4096];
+    int length = snprintf(line, sizeof(line), "head -c %dM /dev/zero", megabytes);
+    for (int i = 0; i < stages && length < (int) sizeof(line) - 8; i++)
+        length += snprintf(line + length, sizeof(line) - length, " | cat");
+
+    double seconds = runShell(shell, "-c", line);
+
+    fprintf(results, "  \"pipeline\": {\"stages\": %d, \"megabytes\": %d, \"seconds\": %.6f, \"megabytes_per_second\": %.1f},\n",
+            stages + 1, megabytes, seconds, seconds > 0 ? megabytes / seconds : 0);
+}
+
+/* Parses lines of a growing number of words. Prints the microseconds per
+ * line of each size as a JSON member. */
+void benchParse(FILE* results) {
+    int sizes[] = {64, 4096, 32768};
+
+    fprintf(results, "  \"parse\": [");
+    for (int i = 0; i < 3; i++) {
+        // Every eighth word starts a new stage and every thirteenth is a redirect
+        char* line = malloc((size_t) sizes[i] * 24 + 2);
+        char* end = line + sprintf(line, "cmd");
+        for (int j = 1; j < sizes[i]; j++) {
+            if (j % 8 == 0)
+                end += sprintf(end, " | cmd%d", j);
+            else if (j % 13 == 0)
+                end += sprintf(end, ">out%d", j);
+            else
+                end += sprintf(end, " arg%d", j);
+        }
+        strcpy(end, "\n");
+
+        int count = 16000 / sizes[i] + 1;
+        Arena arena = {NULL};
+        double start = now();
+        for (int j = 0; j < count; j++) {
+            parseLine(line, &arena);
+            arenaReset(&arena);
+        }
+        double perLine = (now() - start) / count;
+
+        // The same line through parseCmd, which finds it in the parse cache after the first time
+        Cmd* cmd = newCmd();
+        start = now();
+        for (int j = 0; j < count; j++) {
+            parseCmd(cmd, line, strlen(line));
+            resetCmd(cmd);
+        }
+        double perCachedLine = (now() - start) / count;
+        freeCmd(cmd);
+
+        fprintf(results, "%s{\"words\": %d, \"bytes\": %zu, \"us_per_line\": %.3f, \"us_per_cached_line\": %.3f}",
+                i == 0 ? "" : ", ", sizes[i], strlen(line), perLine, perCachedLine);
+        arenaFree(&arena);
+        free(line);
+    }
+    fprintf(results, "],\n");
+}
+
+/* Starts count background sleep jobs, terminates them and reaps them through
+ * the job table. Prints the microseconds per job as a JSON object. */
+void benchReap(FILE* results, int count, int last) {
+    const char* line = "sleep 1000 &\n";
+    int devNull = open("/dev/null", O_WRONLY|O_CLOEXEC);
+    Job** started = malloc(sizeof(Job*) * count);
+
+    double start = now();
+    for (int i = 0; i < count; i++) {
+        Cmd* cmd = newCmd();
+        parseCmd(cmd, line, strlen(line));
+        startPipeline(cmd, STDIN_FILENO, devNull);
+
+        started[i] = newProcess(cmd, STDOUT_FILENO, 0);
+        addProcess(started[i]);
+    }
+    double launched = now() - start;
+
+    for (int i = 0; i < count; i++)
+        signalPipeline(started[i]->cmd, SIGTERM);
+
+    // Only the time spent in the shell reaping and removing jobs is counted
+    int reaped = 0;
+    double reaping = 0;
+    while (reaped < count) {
+        waitForChildSignal();
+        start = now();
+        reaped += checkProcessStatus(NULL);
+        reaping += now() - start;
+    }
+
+    fprintf(results, "{\"jobs\": %d, \"launch_us_per_job\": %.2f, \"reap_us_per_job\": %.3f}%s",
+            count, launched / count, reaping / count, last ? "" : ", ");
+
+    free(started);
+    close(devNull);
+}
+
+int main(int argc, char** argv) {
+    const char* shell = argc > 1 ? argv[1] : "./shell352";
+    int stages = argc > 2 ? atoi(argv[2]) : 4;
+    int megabytes = argc > 3 ? atoi(argv[3]) : 1024;
+
+    // Results go to the original stdout, the messages of the jobs are discarded
+    FILE* results = fdopen(dup(STDOUT_FILENO), "w");
+    int devNull = open("/dev/null", O_WRONLY);
+    dup2(devNull, STDOUT_FILENO);
+    close(devNull);
+
+    fprintf(results, "{\n");
+
+    // Jobs are started with the environment the shell would give them
+    importEnvironment(environ);
+
+    // The shell is run before the reaper is started as it reaps every child
+    benchScript(results, shell, "script_builtin_true", "true", 100000);
+    benchScript(results, shell, "script_program_true", "/bin/true", 5000);
+    benchLoop(results, shell, "loop_builtin_true", "true", 100000);
+    benchLoop(results, shell, "loop_substitution", "x=$(echo $j)", 5000);
+    benchPipeline(results, shell, stages, megabytes);
+    benchParse(results);
+
+    startReaper();
+    fprintf(results, "  \"reap\": [");
+    benchReap(results, 1000, 0);
+    benchReap(results, 10000, 1);
+    fprintf(results, "]\n}\n");
+
+    removeAllProcesses();
+    fclose(results);
+    return 0;
+}
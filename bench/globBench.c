@@ -0,0 +1,113 @@
+/* Benjamin Schroeder
+ *
+ * globBench.c
+ *
+ * A benchmark of matching patterns against file names. A directory is
+ * filled with a growing number of files, a tenth of them ending in '.log',
+ * and every name ending in '.log' is matched repeatedly both with glob(3),
+ * which reads the directory every time, and with the shell's matcher, which
+ * reads it once into its cache and only checks its modification time after
+ * that. The time of the shell's first match, which has to read and sort the
+ * directory, is shown on its own.
+ *
+ * Usage: globBench [iterations] [file counts...]
+ */
+
+#include "../pathGlob.h"
+#include "bench.h"
+#include <fcntl.h>
+#include <glob.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+/* Creates count empty files in directory, every tenth ending in '.log'. */
+void fillDirectory(const char* directory, int count) {
+    char path[4096];
+    for (int i = 0; i < count; i++) {
+        snprintf(path, sizeof(path), "%s/file%07d.%s", directory, i, i % 10 == 0 ? "log" : "dat");
+        close(open(path, O_WRONLY|O_CREAT|O_CLOEXEC, 0644));
+    }
+
+    // The directory is made to look settled so its cached entries are trusted
+    struct timespec times[2];
+    clock_gettime(CLOCK_REALTIME, &times[0]);
+    times[0].tv_sec -= 60;
+    times[1] = times[0];
+    utimensat(AT_FDCWD, directory, times, 0);
+}
+
+/* Removes the files made by fillDirectory along with the directory. */
+void emptyDirectory(const char* directory, int count) {
+    char path[4096];
+    for (int i = 0; i < count; i++) {
+        snprintf(path, sizeof(path), "%s/file%07d.%s", directory, i, i % 10 == 0 ? "log" : "dat");
+        unlink(path);
+    }
+    rmdir(directory);
+}
+
+int main(int argc, char** argv) {
+    int iterations = argc > 1 ? atoi(argv[1]) : 20;
+    int defaultCounts[] = {1000, 20000, 200000};
+    int sizes = argc > 2 ? argc - 2 : 3;
+
+    printf("%8s %8s %12s %12s %12s\n", "files", "matches", "glob() us", "first us", "cached us");
+
+    for (int i = 0; i < sizes; i++) {
+        int count = argc > 2 ? atoi(argv[i + 2]) : defaultCounts[i];
+
+        char directory[] = "/tmp/globBenchXXXXXX";
+        if (mkdtemp(directory) == NULL) {
+            perror("mkdtemp");
+            return 1;
+        }
+        fillDirectory(directory, count);
+
+        // The same pattern written as the lexer leaves it, with the '*' marked
+        char plain[64];
+        char marked[64];
+        snprintf(plain, sizeof(plain), "%s/*.log", directory);
+        snprintf(marked, sizeof(marked), "%s/%c*.log", directory, PATTERN_MARK);
+
+        glob_t found;
+        int expected = 0;
+        double start = now();
+        for (int j = 0; j < iterations; j++) {
+            glob(plain, 0, NULL, &found);
+            expected = (int) found.gl_pathc;
+            globfree(&found);
+        }
+        double perGlob = (now() - start) / iterations;
+
+        // The arena and list are reset after every match the same as in the shell
+        Arena arena = {NULL};
+        GlobMatches matches = {NULL};
+        start = now();
+        int matched = globPattern(marked, &matches, &arena);
+        double first = now() - start;
+
+        start = now();
+        for (int j = 0; j < iterations; j++) {
+            matches.count = 0;
+            arenaReset(&arena);
+            matched = globPattern(marked, &matches, &arena);
+        }
+        double perCached = (now() - start) / iterations;
+
+        if (matched != expected)
+            fprintf(stderr, "globBench: %d matches but glob() found %d\n", matched, expected);
+
+        printf("%8d %8d %12.1f %12.1f %12.1f\n", count, matched, perGlob, first, perCached);
+
+        arenaFree(&arena);
+        free(matches.paths);
+        clearGlobCache();
+        emptyDirectory(directory, count);
+    }
+
+    return 0;
+}
@@ -0,0 +1,82 @@
+/* Benjamin Schroeder
+ *
+ * jobBench.c
+ *
+ * A stress benchmark of the job table. Thousands of background sleep jobs
+ * are started and added to the table, looked up by job number and by the
+ * process id of each stage, then terminated and reaped through the same
+ * path the shell uses, timing each step.
+ *
+ * Usage: jobBench [jobs]
+ */
+
+#include "../processList.h"
+#include "../reaper.h"
+#include "../vars.h"
+#include "bench.h"
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+extern char **environ;
+
+int main(int argc, char** argv) {
+    int count = argc > 1 ? atoi(argv[1]) : 10000;
+    const char* line = "sleep 1000 &\n";
+
+    // Results go to the original stdout, the messages of the jobs are discarded
+    FILE* results = fdopen(dup(STDOUT_FILENO), "w");
+    int devNull = open("/dev/null", O_WRONLY);
+    dup2(devNull, STDOUT_FILENO);
+
+    // Jobs are started with the environment the shell would give them
+    importEnvironment(environ);
+    startReaper();
+
+    // Starts every job and adds it to the table
+    Job** started = malloc(sizeof(Job*) * count);
+    double start = now();
+    for (int i = 0; i < count; i++) {
+        Cmd* cmd = newCmd();
+        parseCmd(cmd, line, strlen(line));
+        startPipeline(cmd, STDIN_FILENO, devNull);
+
+        started[i] = newProcess(cmd, STDOUT_FILENO, 0);
+        addProcess(started[i]);
+    }
+    double launched = now() - start;
+
+    // Finds every job by its number and by its process id
+    start = now();
+    for (int i = 0; i < count; i++) {
+        if (findJob(started[i]->number) != started[i] || findProcess(started[i]->cmd->pid) != started[i])
+            fprintf(results, "lookup failed for job %d\n", started[i]->number);
+    }
+    double lookups = (now() - start) / (count * 2);
+
+    // Terminates every job then reaps them all, timing only the reaping
+    for (int i = 0; i < count; i++)
+        signalPipeline(started[i]->cmd, SIGTERM);
+
+    int reaped = 0;
+    double reaping = 0;
+    while (reaped < count) {
+        waitForChildSignal();
+        start = now();
+        reaped += checkProcessStatus(NULL);
+        reaping += now() - start;
+    }
+
+    fprintf(results, "jobs                 %d\n", count);
+    fprintf(results, "launch + add (us)    %.1f per job\n", launched / count);
+    fprintf(results, "lookup (us)          %.3f per lookup\n", lookups);
+    fprintf(results, "reap + remove (us)   %.1f per job\n", reaping / count);
+
+    removeAllProcesses();
+    free(started);
+    fclose(results);
+    return 0;
+}
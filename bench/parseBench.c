@@ -0,0 +1,68 @@
+/* Benjamin Schroeder
+ *
+ * parseBench.c
+ *
+ * A benchmark of the lexer and parser. Long command lines are generated
+ * with a growing number of arguments, pipes and redirects, and each one is
+ * parsed repeatedly to find the average time taken per line along with the
+ * rate the parser reads input at.
+ *
+ * Usage: parseBench [iterations]
+ */
+
+#include "../parser.h"
+#include "bench.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Generates a line of the given number of words. Every eighth word starts
+ * a new stage and every thirteenth is a redirect written without spaces.
+ * Returns a newly allocated string. */
+char* generateLine(int words) {
+    char* line = malloc((size_t) words * 24 + 2);
+    char* end = line;
+
+    end += sprintf(end, "cmd");
+    for (int i = 1; i < words; i++) {
+        if (i % 8 == 0)
+            end += sprintf(end, " | cmd%d", i);
+        else if (i % 13 == 0)
+            end += sprintf(end, ">out%d", i);
+        else
+            end += sprintf(end, " arg%d", i);
+    }
+    strcpy(end, "\n");
+
+    return line;
+}
+
+int main(int argc, char** argv) {
+    int iterations = argc > 1 ? atoi(argv[1]) : 2000;
+    int sizes[] = {8, 64, 512, 4096, 32768};
+
+    printf("%8s %10s %14s %12s\n", "words", "bytes", "us per line", "MB/s");
+
+    for (int i = 0; i < 5; i++) {
+        char* line = generateLine(sizes[i]);
+        size_t length = strlen(line);
+
+        // Fewer iterations are used for the longest lines
+        int count = iterations * 8 / sizes[i] + 1;
+
+        // The arena is reset after every line the same as in the shell
+        Arena arena = {NULL};
+        double start = now();
+        for (int j = 0; j < count; j++) {
+            parseLine(line, &arena);
+            arenaReset(&arena);
+        }
+        double perLine = (now() - start) / count;
+
+        printf("%8d %10zu %14.2f %12.1f\n", sizes[i], length, perLine, length / perLine);
+        arenaFree(&arena);
+        free(line);
+    }
+
+    return 0;
+}
@@ -0,0 +1,84 @@
+/* Benjamin Schroeder
+ *
+ * replayBench.c
+ *
+ * A benchmark of replaying the captured output of a background job. Memory
+ * files from 1 KB to 1 GB are filled the same way a background job fills
+ * its output file and then replayed into /dev/null and into a pipe read by
+ * another process, reporting the throughput of each.
+ *
+ * Usage: replayBench [largest size in MB]
+ */
+
+#define _GNU_SOURCE
+
+#include "../processList.h"
+#include "bench.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <wait.h>
+#include <sys/mman.h>
+
+/* Creates a memory file holding size bytes, leaving its offset at the end
+ * the same as a finished background job would. */
+int captureOutput(size_t size) {
+    static char block[1 << 16];
+    memset(block, 'x', sizeof(block));
+
+    int file = memfd_create("tmp", MFD_CLOEXEC);
+    for (size_t written = 0; written < size; ) {
+        size_t length = size - written < sizeof(block) ? size - written : sizeof(block);
+        written += write(file, block, length);
+    }
+
+    return file;
+}
+
+/* Replays file into out, returning the throughput in MB/s. */
+double replay(int file, int out, size_t size) {
+    double start = now();
+    off_t copied = replayOutput(file, out);
+    double taken = now() - start;
+
+    if ((size_t) copied != size)
+        fprintf(stderr, "only %lld of %zu bytes were replayed\n", (long long) copied, size);
+
+    return size / taken;
+}
+
+int main(int argc, char** argv) {
+    size_t largest = (argc > 1 ? (size_t) atoi(argv[1]) : 1024) << 20;
+    int devNull = open("/dev/null", O_WRONLY);
+
+    printf("%12s %16s %16s\n", "bytes", "/dev/null MB/s", "pipe MB/s");
+
+    for (size_t size = 1 << 10; size <= largest; size <<= 5) {
+        int file = captureOutput(size);
+
+        double toNull = replay(file, devNull, size);
+
+        // A child drains the pipe the same way a reader of the shell's output would
+        int output[2];
+        pipe(output);
+        pid_t reader = fork();
+        if (reader == 0) {
+            static char buff[1 << 16];
+            close(output[1]);
+            while (read(output[0], buff, sizeof(buff)) > 0);
+            _exit(0);
+        }
+        close(output[0]);
+
+        double toPipe = replay(file, output[1], size);
+        close(output[1]);
+        waitpid(reader, NULL, 0);
+
+        printf("%12zu %16.1f %16.1f\n", size, toNull, toPipe);
+        close(file);
+    }
+
+    return 0;
+}
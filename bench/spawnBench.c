@@ -0,0 +1,104 @@
+/* Benjamin Schroeder
+ *
+ * spawnBench.c
+ *
+ * A benchmark comparing the latency of starting a command with fork and
+ * execve against the posix_spawn launcher used by the shell and against the
+ * zygote used with --zygote. All are measured while the benchmark holds
+ * heaps of different sizes, showing how the cost of fork grows with the
+ * memory of the process that calls it while the cost of posix_spawn and the
+ * zygote does not.
+ *
+ * Usage: spawnBench [iterations] [heap sizes in MB...]
+ */
+
+#define _GNU_SOURCE
+
+#include "../launch.h"
+#include "../zygote.h"
+#include "../vars.h"
+#include "bench.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <wait.h>
+
+extern char **environ;
+
+/* Starts and waits for /bin/true using fork and execve.
+ * Returns the average microseconds taken per command. */
+double forkLatency(int iterations) {
+    char* args[] = {"true", NULL};
+    double start = now();
+
+    for (int i = 0; i < iterations; i++) {
+        pid_t pid = fork();
+        if (pid == 0) {
+            execve("/bin/true", args, environ);
+            _exit(10);
+        }
+        waitpid(pid, NULL, 0);
+    }
+
+    return (now() - start) / iterations;
+}
+
+/* Starts and waits for /bin/true using the shell's launcher.
+ * Returns the average microseconds taken per command. */
+double spawnLatency(int iterations) {
+    char* args[] = {"/bin/true", NULL};
+    const Redirect* failed;
+    double start = now();
+
+    for (int i = 0; i < iterations; i++) {
+        pid_t pid = launch(args, STDIN_FILENO, STDOUT_FILENO, NULL, 0, &failed);
+        waitpid(pid, NULL, 0);
+    }
+
+    return (now() - start) / iterations;
+}
+
+/* Starts and waits for /bin/true through a zygote started for the run.
+ * Returns the average microseconds taken per command, or -1 if the zygote
+ * could not be started. */
+double zygoteLatency(int iterations) {
+    if (startZygote() == -1)
+        return -1;
+
+    // The commands are children of the benchmark, so they are waited for the same way
+    double latency = spawnLatency(iterations);
+    forgetZygote();
+    return latency;
+}
+
+int main(int argc, char** argv) {
+    int iterations = argc > 1 ? atoi(argv[1]) : 500;
+    int defaultSizes[] = {0, 16, 64, 256, 1024};
+    int count = argc > 2 ? argc - 2 : 5;
+
+    // Commands are started with the environment the shell would give them
+    importEnvironment(environ);
+
+    printf("%10s %14s %14s %14s\n", "heap (MB)", "fork+exec (us)", "spawn (us)", "zygote (us)");
+
+    for (int i = 0; i < count; i++) {
+        int size = argc > 2 ? atoi(argv[i + 2]) : defaultSizes[i];
+
+        // Touches every page so it is mapped and must be covered by fork
+        char* heap = NULL;
+        if (size > 0) {
+            heap = malloc((size_t) size << 20);
+            memset(heap, 1, (size_t) size << 20);
+        }
+
+        double forked = forkLatency(iterations);
+        double spawned = spawnLatency(iterations);
+        double zygote = zygoteLatency(iterations);
+        printf("%10d %14.1f %14.1f %14.1f\n", size, forked, spawned, zygote);
+
+        free(heap);
+    }
+
+    return 0;
+}
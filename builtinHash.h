@@ -0,0 +1,6 @@
+/* Created by genBuiltins from builtins.def, do not edit. */
+
+#define BUILTIN_HASH_SEED 2166172511u
+#define BUILTIN_TABLE_SIZE 21
+
+static const signed char builtinSlots[BUILTIN_TABLE_SIZE] = {6, 5, 12, 2, 4, 15, 16, 14, 17, 7, -1, 3, 1, -1, 11, 0, -1, 10, 9, 8, 13};
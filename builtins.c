@@ -0,0 +1,605 @@
+/* Benjamin Schroeder
+ *
+ * builtins.c
+ *
+ * The implementation of the commands built into the shell. Builtins are listed
+ * once in builtins.def, from which genBuiltins creates a perfect hash at
+ * build time, so finding a builtin is a single hash and string compare no
+ * matter how many there are. A builtin given alone in the foreground runs
+ * inside the shell without starting a process, with any redirections applied
+ * to the shell and undone afterwards. In a pipeline or in the background a
+ * builtin runs in a copy of the shell made with fork, which skips executing
+ * a program.
+ */
+
+#define _GNU_SOURCE
+
+#include "builtins.h"
+#include "builtinHash.h"
+#include "launch.h"
+#include "parallel.h"
+#include "pathCache.h"
+#include "processList.h"
+#include "scheduler.h"
+#include "stats.h"
+#include "stream.h"
+#include "trace.h"
+#include "zygote.h"
+#include "vars.h"
+#include "expand.h"
+#include <ctype.h>
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+int subshell = 0;
+
+int lastStatus = 0;
+
+#define BUILTIN(name, function) int function(char** args);
+#include "builtins.def"
+#undef BUILTIN
+
+/* A builtin along with its name, in the order of builtins.def. */
+typedef struct BuiltinEntry {
+    const char* name;
+    Builtin function;
+} BuiltinEntry;
+
+const BuiltinEntry builtinTable[] = {
+#define BUILTIN(name, function) {name, function},
+#include "builtins.def"
+#undef BUILTIN
+};
+
+/* Returns the builtin with the given name or NULL if there is none. */
+Builtin findBuiltin(const char* name) {
+    int index = builtinSlots[hashBuiltin(name, BUILTIN_HASH_SEED) % BUILTIN_TABLE_SIZE];
+
+    if (index == -1 || strcmp(builtinTable[index].name, name) != 0)
+        return NULL;
+    return builtinTable[index].function;
+}
+
+/* Runs a builtin inside the shell with the redirections of stage applied
+ * only while it runs. Returns the exit status of the builtin. */
+int runBuiltin(Builtin builtin, Stage* stage) {
+    int count = stage->redirectCount;
+    if (count == 0)
+        return builtin(stage->args);
+
+    // Keeps the shell's own copy of every descriptor the redirects change so they can be put back
+    fflush(stdout);
+    int fds[count];
+    int saved[count];
+    int savedCount = 0;
+    for (int i = 0; i < count; i++) {
+        int fd = stage->redirects[i].fd;
+        int seen = 0;
+        for (int j = 0; j < savedCount && !seen; j++)
+            seen = fds[j] == fd;
+        if (seen)
+            continue;
+
+        // A descriptor that was not open is closed again afterwards
+        fds[savedCount] = fd;
+        saved[savedCount++] = fcntl(fd, F_DUPFD_CLOEXEC, 10);
+    }
+
+    int status = 1;
+    if (redirectStandard(STDIN_FILENO, STDOUT_FILENO, stage->redirects, count) == 0)
+        status = builtin(stage->args);
+
+    fflush(stdout);
+    for (int i = savedCount - 1; i >= 0; i--) {
+        if (saved[i] == -1) {
+            close(fds[i]);
+        } else {
+            dup2(saved[i], fds[i]);
+            close(saved[i]);
+        }
+    }
+
+    return status;
+}
+
+/* Closes every descriptor marked close on exec, as executing a program
+ * would, so a builtin running in a copy of the shell does not hold the
+ * pipes of its pipeline open. */
+void closeExecDescriptors() {
+    DIR* directory = opendir("/proc/self/fd");
+    if (directory == NULL)
+        return;
+
+    struct dirent* entry;
+    while ((entry = readdir(directory)) != NULL) {
+        int fd = atoi(entry->d_name);
+        if (fd > STDERR_FILENO && fd != dirfd(directory) && (fcntl(fd, F_GETFD) & FD_CLOEXEC))
+            close(fd);
+    }
+
+    closedir(directory);
+}
+
+/* Runs a builtin in a copy of the shell with the same input, output and
+ * redirect handling as launch. Returns the pid of the copy or -1 on failure. */
+pid_t forkBuiltin(Builtin builtin, char** args, int input, int output, const Redirect* redirects, int count) {
+    // Anything left in the buffer would otherwise be printed by both
+    fflush(stdout);
+
+    pid_t pid = fork();
+    if (pid != 0)
+        return pid;
+
+    // The copy keeps the reaper for builtins that start commands, but not the jobs of the shell
+    subshell = 1;
+    signal(SIGTSTP, SIG_DFL);
+    if (placementSet())
+        applyPlacement(&placement);
+    forgetProcesses();
+    forgetStreams();
+    forgetTrace();
+    forgetZygote();
+
+    int status = 1;
+    if (redirectStandard(input, output, redirects, count) == 0) {
+        closeExecDescriptors();
+        status = builtin(args);
+    }
+
+    fflush(stdout);
+    _exit(status);
+}
+
+/* Changes the working directory to args[1], HOME when not given or the
+ * previous directory when given '-'. */
+int builtinCd(char** args) {
+    const char* directory = args[1] != NULL ? args[1] : getVariable("HOME");
+
+    if (directory != NULL && strcmp(directory, "-") == 0) {
+        directory = getVariable("OLDPWD");
+        if (directory != NULL)
+            printf("%s\n", directory);
+    }
+
+    if (directory == NULL) {
+        fprintf(stderr, "cd: %s not set\n", args[1] != NULL ? "OLDPWD" : "HOME");
+        return 1;
+    }
+
+    char* previous = getcwd(NULL, 0);
+    if (chdir(directory) == -1) {
+        fprintf(stderr, "cd: %s: %s\n", directory, strerror(errno));
+        free(previous);
+        return 1;
+    }
+
+    char* current = getcwd(NULL, 0);
+    if (previous != NULL)
+        setVariable("OLDPWD", previous);
+    if (current != NULL)
+        setVariable("PWD", current);
+    free(previous);
+    free(current);
+
+    return 0;
+}
+
+/* Prints the working directory. */
+int builtinPwd(char** args) {
+    char* current = getcwd(NULL, 0);
+
+    if (current == NULL) {
+        fprintf(stderr, "pwd: %s\n", strerror(errno));
+        return 1;
+    }
+
+    printf("%s\n", current);
+    free(current);
+    return 0;
+}
+
+/* Prints the arguments separated by spaces, without the newline when
+ * the first argument is -n. */
+int builtinEcho(char** args) {
+    int newline = args[1] == NULL || strcmp(args[1], "-n") != 0;
+
+    for (int i = newline ? 1 : 2; args[i] != NULL; i++) {
+        if (i > (newline ? 1 : 2))
+            putchar(' ');
+        fputs(args[i], stdout);
+    }
+
+    if (newline)
+        putchar('\n');
+    return 0;
+}
+
+/* Does nothing successfully. */
+int builtinTrue(char** args) {
+    return 0;
+}
+
+/* Does nothing unsuccessfully. */
+int builtinFalse(char** args) {
+    return 1;
+}
+
+/* Reads an integer argument of test into value.
+ * Returns -1 after printing a message if it is not an integer. */
+int testInteger(const char* arg, long* value) {
+    char* end;
+
+    errno = 0;
+    *value = strtol(arg, &end, 10);
+    if (*arg == '\0' || *end != '\0' || errno != 0) {
+        fprintf(stderr, "test: %s: integer expression expected\n", arg);
+        return -1;
+    }
+    return 0;
+}
+
+/* Evaluates a test expression made up of count arguments.
+ * Returns 0 if it is true, 1 if it is false or 2 if it is malformed. */
+int evaluateTest(char** args, int count) {
+    if (count == 0)
+        return 1;
+
+    // A leading '!' negates the rest of the expression
+    if (strcmp(args[0], "!") == 0) {
+        int result = evaluateTest(args + 1, count - 1);
+        return result == 2 ? 2 : !result;
+    }
+
+    // A single argument is true when it is not empty
+    if (count == 1)
+        return args[0][0] == '\0';
+
+    if (count == 2) {
+        const char* op = args[0];
+        const char* arg = args[1];
+
+        if (strcmp(op, "-n") == 0)
+            return arg[0] == '\0';
+        if (strcmp(op, "-z") == 0)
+            return arg[0] != '\0';
+
+        // Only the operators about the kind and size of a file need it to be looked at
+        struct stat info;
+        int exists = (strcmp(op, "-e") == 0 || strcmp(op, "-f") == 0 || strcmp(op, "-d") == 0
+                      || strcmp(op, "-s") == 0) && stat(arg, &info) == 0;
+
+        if (strcmp(op, "-e") == 0)
+            return !exists;
+        if (strcmp(op, "-f") == 0)
+            return !(exists && S_ISREG(info.st_mode));
+        if (strcmp(op, "-d") == 0)
+            return !(exists && S_ISDIR(info.st_mode));
+        if (strcmp(op, "-s") == 0)
+            return !(exists && info.st_size > 0);
+        if (strcmp(op, "-r") == 0)
+            return access(arg, R_OK) != 0;
+        if (strcmp(op, "-w") == 0)
+            return access(arg, W_OK) != 0;
+        if (strcmp(op, "-x") == 0)
+            return access(arg, X_OK) != 0;
+
+        fprintf(stderr, "test: %s: unary operator expected\n", op);
+        return 2;
+    }
+
+    if (count == 3) {
+        const char* op = args[1];
+
+        if (strcmp(op, "=") == 0 || strcmp(op, "==") == 0)
+            return strcmp(args[0], args[2]) != 0;
+        if (strcmp(op, "!=") == 0)
+            return strcmp(args[0], args[2]) == 0;
+
+        // The rest of the operators compare integers
+        long left, right;
+        const char* ops[] = {"-eq", "-ne", "-lt", "-le", "-gt", "-ge"};
+        int which = -1;
+        for (int i = 0; i < 6; i++) {
+            if (strcmp(op, ops[i]) == 0)
+                which = i;
+        }
+
+        if (which == -1) {
+            fprintf(stderr, "test: %s: binary operator expected\n", op);
+            return 2;
+        }
+        if (testInteger(args[0], &left) == -1 || testInteger(args[2], &right) == -1)
+            return 2;
+
+        switch (which) {
+            case 0: return !(left == right);
+            case 1: return !(left != right);
+            case 2: return !(left < right);
+            case 3: return !(left <= right);
+            case 4: return !(left > right);
+            default: return !(left >= right);
+        }
+    }
+
+    fprintf(stderr, "test: too many arguments\n");
+    return 2;
+}
+
+/* Evaluates a conditional expression, as test or as '[' ending with ']'. */
+int builtinTest(char** args) {
+    int count = 0;
+    while (args[count + 1] != NULL)
+        count++;
+
+    if (strcmp(args[0], "[") == 0) {
+        if (count == 0 || strcmp(args[count], "]") != 0) {
+            fprintf(stderr, "[: missing ']'\n");
+            return 2;
+        }
+        count--;
+    }
+
+    return evaluateTest(args + 1, count);
+}
+
+/* Exports the variables given as NAME=VALUE or NAME, or prints the
+ * exported variables when given nothing. */
+int builtinExport(char** args) {
+    if (args[1] == NULL) {
+        printVariables("export ", 1);
+        return 0;
+    }
+
+    int status = 0;
+    for (int i = 1; args[i] != NULL; i++) {
+        size_t length = nameLength(args[i]);
+
+        if (length == 0 || (args[i][length] != '=' && args[i][length] != '\0')) {
+            fprintf(stderr, "export: %s: not a valid identifier\n", args[i]);
+            status = 1;
+        } else if (args[i][length] == '=') {
+            args[i][length] = '\0';
+            exportVariable(args[i], args[i] + length + 1);
+            args[i][length] = '=';
+        } else {
+            exportVariable(args[i], NULL);
+        }
+    }
+
+    return status;
+}
+
+/* Removes the variables named by args. */
+int builtinUnset(char** args) {
+    int status = 0;
+    for (int i = 1; args[i] != NULL; i++) {
+        if (nameLength(args[i]) != strlen(args[i])) {
+            fprintf(stderr, "unset: %s: not a valid identifier\n", args[i]);
+            status = 1;
+        } else {
+            unsetVariable(args[i]);
+        }
+    }
+
+    return status;
+}
+
+/* Sets a shell variable for each NAME=VALUE word of args, run in place of a
+ * command made only of assignments. Returns the exit status of the last
+ * command substituted into the values, or 0 if there was none. */
+int assignVariables(char** args) {
+    for (int i = 0; args[i] != NULL; i++) {
+        size_t length = nameLength(args[i]);
+        args[i][length] = '\0';
+        setVariable(args[i], args[i] + length + 1);
+        args[i][length] = '=';
+    }
+
+    return substitutionStatus;
+}
+
+/* Returns 1 if every word of args is a NAME=VALUE assignment. */
+int onlyAssignments(char** args) {
+    for (int i = 0; args[i] != NULL; i++) {
+        if (!isAssignment(args[i]))
+            return 0;
+    }
+    return 1;
+}
+
+/* Exits the shell with the status args[1], or that of the last command
+ * when not given. */
+int builtinExit(char** args) {
+    int status = args[1] != NULL ? atoi(args[1]) : lastStatus;
+
+    // A copy of the shell only ends itself
+    if (subshell)
+        return status;
+
+    removeAllProcesses();
+    exit(status);
+}
+
+/* Prints the status of every background job, along with the resources
+ * used by each stage when given -l. */
+int builtinJobs(char** args) {
+    printProcess(args[1] != NULL && strcmp(args[1], "-l") == 0);
+    return 0;
+}
+
+/* Reads a job number, given with or without a leading '%'.
+ * Returns the number, or -1 if arg is not a positive whole number. */
+int jobNumber(const char* arg) {
+    char* end;
+
+    if (*arg == '%')
+        arg++;
+    errno = 0;
+    long number = strtol(arg, &end, 10);
+    if (*arg == '\0' || *end != '\0' || errno != 0 || number <= 0 || number > INT_MAX)
+        return -1;
+    return (int) number;
+}
+
+/* Continues the job args[1], or the highest job, in the foreground.
+ * Returns the exit status of the job, or 128 plus SIGTSTP if it stopped. */
+int builtinFg(char** args) {
+    int number = args[1] != NULL ? jobNumber(args[1]) : 0;
+    if (number == -1) {
+        fprintf(stderr, "fg: %s: not a job number\n", args[1]);
+        return 1;
+    }
+
+    int result = foregroundProcess(number);
+
+    if (result == -1) {
+        fprintf(stderr, "fg: no such job\n");
+        return 1;
+    }
+    return result;
+}
+
+/* Continues the stopped job args[1] in the background. With --max sets the
+ * most background jobs running at once, and with a command queues it as a
+ * background job started with the priority given by --prio on the CPUs
+ * given by --cpus. */
+int builtinBg(char** args) {
+    int priority = 0;
+    char* cpus = NULL;
+    int i = 1;
+
+    for (; args[i] != NULL && strncmp(args[i], "--", 2) == 0; i += 2) {
+        if (args[i + 1] == NULL) {
+            fprintf(stderr, "bg: %s: option requires a value\n", args[i]);
+            return 1;
+        }
+
+        if (strcmp(args[i], "--max") == 0) {
+            maxRunningJobs = atoi(args[i + 1]) > 0 ? atoi(args[i + 1]) : 0;
+            admitProcesses();
+        } else if (strcmp(args[i], "--prio") == 0) {
+            priority = atoi(args[i + 1]);
+        } else if (strcmp(args[i], "--cpus") == 0 && checkCpuList(args[i + 1]) == 0) {
+            cpus = args[i + 1];
+        } else {
+            fprintf(stderr, "bg: %s %s: invalid option\n", args[i], args[i + 1]);
+            return 1;
+        }
+    }
+
+    if (args[i] == NULL)
+        return 0;
+
+    // A job number continues that job
+    if (args[i + 1] == NULL && jobNumber(args[i]) > 0) {
+        if (resumeProcess(jobNumber(args[i])) == 1) {
+            printf("Could Not Resume Command\n");
+            return 1;
+        }
+        return 0;
+    }
+
+    // Anything else is a command, quoted so it is parsed back into the same arguments
+    char* line = NULL;
+    size_t used = 0;
+    size_t capacity = 0;
+    for (; args[i] != NULL; i++)
+        appendQuoted(&line, &used, &capacity, args[i]);
+    appendText(&line, &used, &capacity, "&\n", 2);
+
+    Cmd* cmd = newCmd();
+    int parsed = parseCmd(cmd, line, used);
+    free(line);
+    if (parsed == -1) {
+        freeCmd(cmd);
+        return 1;
+    }
+
+    Job* job = newProcess(cmd, STDOUT_FILENO, 0);
+    job->streaming = streamEnabled;
+    job->priority = priority;
+    job->cpus = cpus != NULL ? strdup(cpus) : NULL;
+
+    return queueProcess(job) == -1 ? 1 : 0;
+}
+
+/* Waits for the jobs given, or every background job, to finish. With -n
+ * waits for only the first of them to finish. */
+int builtinWait(char** args) {
+    int any = args[1] != NULL && strcmp(args[1], "-n") == 0;
+    int count = 0;
+    int* numbers = (int*) malloc(sizeof(int) * 8);
+
+    for (int i = any ? 2 : 1; args[i] != NULL; i++) {
+        int number = jobNumber(args[i]);
+        if (number == -1) {
+            fprintf(stderr, "wait: %s: not a job number\n", args[i]);
+            free(numbers);
+            return 2;
+        }
+
+        if ((count & (count - 1)) == 0 && count >= 8)
+            numbers = (int*) realloc(numbers, sizeof(int) * count * 2);
+        numbers[count++] = number;
+    }
+
+    int status = waitProcesses(numbers, count, any);
+    free(numbers);
+    return status;
+}
+
+/* Lists the path cache, clears it with -r, or looks up the names given. */
+int builtinHash(char** args) {
+    if (args[1] == NULL) {
+        pathCachePrint();
+        return 0;
+    }
+
+    if (strcmp(args[1], "-r") == 0) {
+        pathCacheClear();
+        return 0;
+    }
+
+    int status = 0;
+    for (int i = 1; args[i] != NULL; i++) {
+        if (pathCacheLookup(args[i]) == NULL) {
+            printf("hash: %s: not found\n", args[i]);
+            status = 1;
+        }
+    }
+    return status;
+}
+
+/* Lists the shell options, or turns one on with -o and off with +o. */
+int builtinSet(char** args) {
+    if (args[1] == NULL || args[2] == NULL) {
+        printf("stream\t%s\n", streamEnabled ? "on" : "off");
+        printf("trace\t%s\n", traceEnabled ? "on" : "off");
+        return 0;
+    }
+
+    if (strcmp(args[2], "stream") == 0 && strcmp(args[1], "-o") == 0) {
+        streamEnabled = 1;
+    } else if (strcmp(args[2], "stream") == 0 && strcmp(args[1], "+o") == 0) {
+        streamEnabled = 0;
+
+    // Traces to the file named by SHELL352_TRACE, or one in the current directory
+    } else if (strcmp(args[2], "trace") == 0 && strcmp(args[1], "-o") == 0) {
+        const char* path = getVariable(TRACE_VARIABLE);
+        return startTrace(path != NULL && path[0] != '\0' ? path : TRACE_DEFAULT_FILE) == -1 ? 1 : 0;
+    } else if (strcmp(args[2], "trace") == 0 && strcmp(args[1], "+o") == 0) {
+        stopTrace();
+    } else {
+        fprintf(stderr, "set: %s %s: invalid option\n", args[1], args[2]);
+        return 1;
+    }
+    return 0;
+}
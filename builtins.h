@@ -0,0 +1,63 @@
+/* Benjamin Schroeder
+ *
+ * builtins.h
+ *
+ * The header file for the commands built into the shell. Builtins are listed
+ * once in builtins.def, from which genBuiltins creates a perfect hash at
+ * build time, so finding a builtin is a single hash and string compare no
+ * matter how many there are. A builtin given alone in the foreground runs
+ * inside the shell without starting a process, with any redirections applied
+ * to the shell and undone afterwards. In a pipeline or in the background a
+ * builtin runs in a copy of the shell made with fork, which skips executing
+ * a program.
+ */
+
+#ifndef CS352P1_BUILTINS_H
+#define CS352P1_BUILTINS_H
+
+#include "parser.h"
+#include <sys/types.h>
+
+/* A builtin, given its arguments and returning its exit status. */
+typedef int (*Builtin)(char** args);
+
+/* Set in a copy of the shell running a builtin, where builtins that change
+ * the shell such as exit only affect the copy. */
+extern int subshell;
+
+/* The exit status of the last command, used when exit is not given one. */
+extern int lastStatus;
+
+/* Hashes the name of a builtin with the given seed. Shared by the shell and
+ * genBuiltins so both find the same slots. */
+static inline unsigned int hashBuiltin(const char* name, unsigned int seed) {
+    unsigned int hash = seed;
+
+    for (; *name != '\0'; name++) {
+        hash ^= (unsigned char) *name;
+        hash *= 16777619u;
+    }
+
+    return hash;
+}
+
+/* Returns the builtin with the given name or NULL if there is none. */
+Builtin findBuiltin(const char* name);
+
+/* Sets a shell variable for each NAME=VALUE word of args, run in place of a
+ * command made only of assignments. Returns the exit status of the last
+ * command substituted into the values, or 0 if there was none. */
+int assignVariables(char** args);
+
+/* Returns 1 if every word of args is a NAME=VALUE assignment. */
+int onlyAssignments(char** args);
+
+/* Runs a builtin inside the shell with the redirections of stage applied
+ * only while it runs. Returns the exit status of the builtin. */
+int runBuiltin(Builtin builtin, Stage* stage);
+
+/* Runs a builtin in a copy of the shell with the same input, output and
+ * redirect handling as launch. Returns the pid of the copy or -1 on failure. */
+pid_t forkBuiltin(Builtin builtin, char** args, int input, int output, const Redirect* redirects, int count);
+
+#endif //CS352P1_BUILTINS_H
@@ -0,0 +1,311 @@
+/* Benjamin Schroeder
+ *
+ * expand.c
+ *
+ * The implementation of expanding the words of a command just before it runs.
+ * The lexer leaves the name of every variable between marks in the text of
+ * a word, so a parsed pipeline, whether it was just parsed or taken from a
+ * cached plan, is expanded with the values the variables have at the time
+ * it runs. The command of each $(...) or `...` is run the same way and
+ * replaced by its output. Variables and substitutions outside double quotes
+ * are split into many words on the characters of IFS, and words that expand
+ * to nothing are dropped. Words holding unquoted '*', '?' or '[...]' are
+ * then replaced by the files they match. Words without variables,
+ * substitutions or patterns are left as they are, so pipelines without any
+ * cost nothing to expand.
+ */
+
+#include "expand.h"
+#include "vars.h"
+#include "pathGlob.h"
+#include "builtins.h"
+#include "substitute.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/* The exit status of the last command substituted, read by a command made
+ * only of assignments. */
+int substitutionStatus = 0;
+
+// The word being built, grown to fit the longest word expanded
+char* field = NULL;
+size_t fieldLength = 0;
+size_t fieldCapacity = 0;
+
+// The words expanded so far, copied into the arena once they are all done
+char** fields = NULL;
+int fieldCount = 0;
+int fieldCapacityCount = 0;
+
+// The words of a single word that may hold patterns, and the paths a pattern matched
+char** patterns = NULL;
+int patternCapacity = 0;
+GlobMatches matches = {NULL};
+
+/* Adds c to the end of the word being built. */
+void appendField(char c) {
+    if (fieldLength == fieldCapacity) {
+        fieldCapacity = fieldCapacity == 0 ? 256 : fieldCapacity * 2;
+        field = (char*) realloc(field, fieldCapacity);
+    }
+    field[fieldLength++] = c;
+}
+
+/* Adds word to the end of the list of words. */
+void addField(char* word) {
+    if (fieldCount == fieldCapacityCount) {
+        fieldCapacityCount = fieldCapacityCount == 0 ? 64 : fieldCapacityCount * 2;
+        fields = (char**) realloc(fields, sizeof(char*) * fieldCapacityCount);
+    }
+    fields[fieldCount++] = word;
+}
+
+/* Adds the word being built to the list of words and starts the next. */
+void endField(Arena* arena) {
+    addField(arenaCopy(arena, field, fieldLength));
+    fieldLength = 0;
+}
+
+/* Returns the value of the variable with the length bytes of name, with
+ * $? and $$ giving the status of the last command and the shell's process
+ * id. A variable that is not set is empty. */
+const char* variableValue(const char* name, size_t length, char* number) {
+    if (length == 1 && name[0] == '?') {
+        sprintf(number, "%d", lastStatus);
+        return number;
+    }
+    if (length == 1 && name[0] == '$') {
+        sprintf(number, "%d", (int) getpid());
+        return number;
+    }
+
+    const char* value = findVariable(name, length);
+    return value != NULL ? value : "";
+}
+
+/* Returns 1 if c is the mark starting a variable or substitution that is
+ * inside double quotes. */
+int isQuotedMark(char c) {
+    return c == QUOTED_EXPAND_MARK || c == QUOTED_SUBSTITUTE_MARK;
+}
+
+/* Returns 1 if c is a character that matches file names. */
+int isPatternCharacter(char c) {
+    return c == '*' || c == '?' || c == '[';
+}
+
+/* Splits the length bytes of output on the characters of separators where
+ * it lies in the arena, adding each word to the list of words without
+ * copying it. Only a word holding characters that match file names is
+ * copied, to mark them. */
+void splitInPlace(char* output, size_t length, const char* separators, Arena* arena) {
+    char* start = NULL;
+    int pattern = 0;
+
+    for (char* c = output; c <= output + length; c++) {
+        if (c < output + length && strchr(separators, *c) == NULL) {
+            if (start == NULL)
+                start = c;
+            pattern |= isPatternCharacter(*c);
+            continue;
+        }
+
+        if (start == NULL)
+            continue;
+        *c = '\0';
+
+        if (pattern) {
+            for (const char* p = start; *p != '\0'; p++) {
+                if (isPatternCharacter(*p))
+                    appendField(PATTERN_MARK);
+                appendField(*p);
+            }
+            endField(arena);
+        } else {
+            addField(start);
+        }
+        start = NULL;
+        pattern = 0;
+    }
+}
+
+/* Expands word onto the end of the list of words. Variables and
+ * substitutions outside double quotes are split on the characters of IFS
+ * when split is set. */
+void expandInto(const char* word, int split, Arena* arena) {
+    const char* separators = getVariable("IFS");
+    if (separators == NULL)
+        separators = DEFAULT_IFS;
+
+    // Set once the word being built has something in it, even if only an empty quoted variable
+    int present = 0;
+    char number[16];
+
+    for (const char* c = word; *c != '\0'; c++) {
+        if (*c != EXPAND_MARK && *c != QUOTED_EXPAND_MARK && *c != SUBSTITUTE_MARK && *c != QUOTED_SUBSTITUTE_MARK) {
+            appendField(*c);
+            present = 1;
+            continue;
+        }
+
+        const char* name = c + 1;
+        const char* end = strchr(name, EXPAND_END);
+        const char* value;
+        int splitValue = split && !isQuotedMark(*c);
+
+        if (*c == SUBSTITUTE_MARK || *c == QUOTED_SUBSTITUTE_MARK) {
+            size_t length;
+            char* output = substituteCommand(name, end - name, &length, &substitutionStatus, arena);
+
+            // A substitution making up the whole word is split where it was read
+            if (splitValue && c == word && end[1] == '\0') {
+                splitInPlace(output, length, separators, arena);
+                return;
+            }
+            value = output;
+        } else {
+            value = variableValue(name, end - name, number);
+        }
+
+        // Separators in the value end the word being built, ignoring any in a row
+        for (const char* v = value; *v != '\0'; v++) {
+            if (splitValue && strchr(separators, *v) != NULL) {
+                if (present)
+                    endField(arena);
+                present = 0;
+                continue;
+            }
+
+            // A value outside quotes can match file names the same as the word around it
+            if (splitValue && isPatternCharacter(*v))
+                appendField(PATTERN_MARK);
+            appendField(*v);
+            present = 1;
+        }
+        if (isQuotedMark(*c))
+            present = 1;
+
+        c = end;
+    }
+
+    if (present)
+        endField(arena);
+}
+
+/* Returns 1 if word holds a variable or substitution to expand. */
+int hasVariable(const char* word) {
+    for (; *word != '\0'; word++) {
+        if (*word == EXPAND_MARK || *word == QUOTED_EXPAND_MARK || *word == SUBSTITUTE_MARK || *word == QUOTED_SUBSTITUTE_MARK)
+            return 1;
+    }
+    return 0;
+}
+
+/* Replaces the words from the first onwards that hold patterns with the
+ * paths they match, or removes their marks if they match nothing or glob is
+ * not set. */
+void globFields(int first, int glob, Arena* arena) {
+    // The words are taken off the list and put back one at a time
+    int count = fieldCount - first;
+    if (count > patternCapacity) {
+        patternCapacity = count * 2;
+        patterns = (char**) realloc(patterns, sizeof(char*) * patternCapacity);
+    }
+    memcpy(patterns, fields + first, sizeof(char*) * count);
+    fieldCount = first;
+
+    for (int i = 0; i < count; i++) {
+        if (strchr(patterns[i], PATTERN_MARK) == NULL) {
+            addField(patterns[i]);
+            continue;
+        }
+
+        matches.count = 0;
+        if (glob && hasGlob(patterns[i]) && globPattern(patterns[i], &matches, arena) > 0) {
+            for (int j = 0; j < matches.count; j++)
+                addField(matches.paths[j]);
+        } else {
+            addField(removeGlobMarks(patterns[i], arena));
+        }
+    }
+}
+
+/* Expands count words into a NULL terminated list taken from arena, with
+ * leading NAME=VALUE words neither split nor matched against file names
+ * when assignments is set. */
+char** expandList(char** words, int count, int assignments, int* expandedCount, Arena* arena) {
+    fieldCount = 0;
+    fieldLength = 0;
+
+    for (int i = 0; i < count; i++) {
+        if (assignments && !isAssignment(words[i]))
+            assignments = 0;
+
+        // Words without variables are kept as they are
+        int first = fieldCount;
+        if (hasVariable(words[i]))
+            expandInto(words[i], !assignments, arena);
+        else
+            addField(words[i]);
+
+        globFields(first, !assignments, arena);
+    }
+
+    char** expanded = (char**) arenaAlloc(arena, sizeof(char*) * (fieldCount + 1));
+    memcpy(expanded, fields, sizeof(char*) * fieldCount);
+    expanded[fieldCount] = NULL;
+
+    *expandedCount = fieldCount;
+    return expanded;
+}
+
+/* Expands count words, splitting variables and substitutions outside
+ * double quotes and matching patterns against file names, into a NULL
+ * terminated list taken from arena. The number of words in the list is
+ * stored in expandedCount. */
+char** expandWords(char** words, int count, int* expandedCount, Arena* arena) {
+    return expandList(words, count, 0, expandedCount, arena);
+}
+
+/* Expands the variables and substitutions of a single word without
+ * splitting it or matching it against file names, such as the name of a
+ * file. Returns the word itself if it has nothing to expand, otherwise a
+ * copy taken from arena. */
+char* expandWord(char* word, Arena* arena) {
+    if (!hasVariable(word))
+        return strchr(word, PATTERN_MARK) != NULL ? removeGlobMarks(word, arena) : word;
+
+    fieldCount = 0;
+    fieldLength = 0;
+    expandInto(word, 0, arena);
+
+    // A word made only of empty variables is still an empty word
+    if (fieldCount == 0)
+        return arenaCopy(arena, "", 0);
+    return strchr(fields[0], PATTERN_MARK) != NULL ? removeGlobMarks(fields[0], arena) : fields[0];
+}
+
+/* Expands the arguments and file names of every stage of pipeline, with
+ * the expanded words taken from arena. The values of leading NAME=VALUE
+ * words are neither split nor matched against file names. */
+void expandPipeline(Pipeline* pipeline, Arena* arena) {
+    for (int i = 0; i < pipeline->stageCount; i++) {
+        Stage* stage = &pipeline->stages[i];
+
+        stage->args = expandList(stage->args, stage->argCount, 1, &stage->argCount, arena);
+
+        // A stage left without words is reported as not found, unless it is the only one
+        if (stage->argCount == 0 && pipeline->stageCount > 1) {
+            stage->args = (char**) arenaAlloc(arena, sizeof(char*) * 2);
+            stage->args[0] = arenaCopy(arena, "", 0);
+            stage->args[1] = NULL;
+            stage->argCount = 1;
+        }
+        for (int j = 0; j < stage->redirectCount; j++) {
+            if (stage->redirects[j].file != NULL)
+                stage->redirects[j].file = expandWord(stage->redirects[j].file, arena);
+        }
+    }
+}
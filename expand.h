@@ -0,0 +1,46 @@
+/* Benjamin Schroeder
+ *
+ * expand.h
+ *
+ * The header file for expanding the words of a command just before it runs.
+ * The lexer leaves the name of every variable between marks in the text of
+ * a word, so a parsed pipeline, whether it was just parsed or taken from a
+ * cached plan, is expanded with the values the variables have at the time
+ * it runs. The command of each $(...) or `...` is run the same way and
+ * replaced by its output. Variables and substitutions outside double quotes
+ * are split into many words on the characters of IFS, and words that expand
+ * to nothing are dropped. Words holding unquoted '*', '?' or '[...]' are
+ * then replaced by the files they match. Words without variables,
+ * substitutions or patterns are left as they are, so pipelines without any
+ * cost nothing to expand.
+ */
+
+#ifndef CS352P1_EXPAND_H
+#define CS352P1_EXPAND_H
+
+#include "shellVariables.h"
+#include "parser.h"
+#include "arena.h"
+
+/* The exit status of the last command substituted, read by a command made
+ * only of assignments. */
+extern int substitutionStatus;
+
+/* Expands count words, splitting variables and substitutions outside
+ * double quotes and matching patterns against file names, into a NULL
+ * terminated list taken from arena. The number of words in the list is
+ * stored in expandedCount. */
+char** expandWords(char** words, int count, int* expandedCount, Arena* arena);
+
+/* Expands the variables and substitutions of a single word without
+ * splitting it or matching it against file names, such as the name of a
+ * file. Returns the word itself if it has nothing to expand, otherwise a
+ * copy taken from arena. */
+char* expandWord(char* word, Arena* arena);
+
+/* Expands the arguments and file names of every stage of pipeline, with
+ * the expanded words taken from arena. The values of leading NAME=VALUE
+ * words are neither split nor matched against file names. */
+void expandPipeline(Pipeline* pipeline, Arena* arena);
+
+#endif //CS352P1_EXPAND_H
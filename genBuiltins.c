@@ -0,0 +1,60 @@
+/* Benjamin Schroeder
+ *
+ * genBuiltins.c
+ *
+ * Creates builtinHash.h from the names in builtins.def at build time. Tries
+ * table sizes starting from the number of builtins, and seeds for each size,
+ * until every name hashes to its own slot. The header holds the seed, the
+ * table size and the slot table mapping each slot to a builtin.
+ */
+
+#include "builtins.h"
+#include <stdio.h>
+#include <string.h>
+
+// The names in the order of builtins.def
+const char* names[] = {
+#define BUILTIN(name, function) name,
+#include "builtins.def"
+#undef BUILTIN
+};
+
+#define NAME_COUNT ((int) (sizeof(names) / sizeof(names[0])))
+
+/* Fills slots for the given size and seed. Returns 1 if no two names share a slot. */
+int tryHash(int* slots, unsigned int size, unsigned int seed) {
+    for (unsigned int i = 0; i < size; i++)
+        slots[i] = -1;
+
+    for (int i = 0; i < NAME_COUNT; i++) {
+        unsigned int slot = hashBuiltin(names[i], seed) % size;
+        if (slots[slot] != -1)
+            return 0;
+        slots[slot] = i;
+    }
+
+    return 1;
+}
+
+int main(void) {
+    int slots[NAME_COUNT * 4];
+
+    for (unsigned int size = NAME_COUNT; size <= NAME_COUNT * 4; size++) {
+        for (unsigned int seed = 2166136261u; seed < 2166136261u + 1000000; seed++) {
+            if (!tryHash(slots, size, seed))
+                continue;
+
+            printf("/* Created by genBuiltins from builtins.def, do not edit. */\n\n");
+            printf("#define BUILTIN_HASH_SEED %uu\n", seed);
+            printf("#define BUILTIN_TABLE_SIZE %u\n\n", size);
+            printf("static const signed char builtinSlots[BUILTIN_TABLE_SIZE] = {");
+            for (unsigned int i = 0; i < size; i++)
+                printf(i == 0 ? "%d" : ", %d", slots[i]);
+            printf("};\n");
+            return 0;
+        }
+    }
+
+    fprintf(stderr, "genBuiltins: no perfect hash found\n");
+    return 1;
+}
@@ -0,0 +1,388 @@
+/* Benjamin Schroeder
+ *
+ * launch.c
+ *
+ * The implementation of the launcher used to start commands that do not need
+ * a copy of the shell. Commands are started with posix_spawn, which creates
+ * the child without duplicating the shell's memory, so the cost of starting
+ * a command stays the same no matter how large the shell has grown. The
+ * redirects of the command, resolved into changes to its descriptors when
+ * it was parsed, become spawn file actions so nothing has to run inside the
+ * child before the command is executed. The stages of a job with a nice
+ * value or CPUs are started from a clone of the shell that sets them first.
+ */
+
+#define _GNU_SOURCE
+
+#include "launch.h"
+#include "pathCache.h"
+#include "trace.h"
+#include "zygote.h"
+#include "vars.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <spawn.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/uio.h>
+
+Placement placement = {0};
+
+// A command started by spawnPlaced, shared with the clone that executes it
+typedef struct PlacedRequest {
+    const char* path;
+    char** args;
+    char** env;
+    int input;
+    int output;
+    const Redirect* redirects;
+    int count;
+    // Set by the clone when it cannot execute the command
+    int error;
+    const Redirect* failed;
+} PlacedRequest;
+
+/* Has every command started from now on run with the given nice value and,
+ * unless cpus is NULL, only on cpus. Clears the errors of the last placement. */
+void setPlacement(int nice, const cpu_set_t* cpus) {
+    placement.nice = nice;
+    placement.pinned = cpus != NULL;
+    if (cpus != NULL)
+        placement.cpus = *cpus;
+    placement.niceError = 0;
+    placement.cpusError = 0;
+}
+
+/* Returns 1 if commands are being started with a nice value or CPUs. */
+int placementSet() {
+    return placement.nice != 0 || placement.pinned;
+}
+
+/* Applies a placement to the calling process, recording the error of each
+ * setting that could not be applied in it. */
+void applyPlacement(Placement* placement) {
+    if (placement->nice != 0 && setpriority(PRIO_PROCESS, 0, placement->nice) == -1)
+        placement->niceError = errno;
+    if (placement->pinned && sched_setaffinity(0, sizeof(cpu_set_t), &placement->cpus) == -1)
+        placement->cpusError = errno;
+}
+
+/* Runs in the clone made by spawnPlaced, sharing the memory of the shell
+ * until it executes. Applies the placement, then sets up the input, output
+ * and redirects of the command the same way as the file actions of launch. */
+int placedChild(void* argument) {
+    PlacedRequest* request = (PlacedRequest*) argument;
+
+    // A handler of the shell must not run on its memory, so caught signals are set back before unblocking
+    for (int i = 1; i < NSIG; i++) {
+        struct sigaction action;
+        if (sigaction(i, NULL, &action) == 0 && action.sa_handler != SIG_DFL && action.sa_handler != SIG_IGN) {
+            action.sa_handler = SIG_DFL;
+            action.sa_flags = 0;
+            sigaction(i, &action, NULL);
+        }
+    }
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigprocmask(SIG_SETMASK, &mask, NULL);
+
+    // Written to the placement of the shell, which shares the memory
+    applyPlacement(&placement);
+
+    dup2(request->input, STDIN_FILENO);
+    dup2(request->output, STDOUT_FILENO);
+
+    if (applyRedirects(request->redirects, request->count, &request->failed) == -1) {
+        request->error = errno;
+        _exit(127);
+    }
+
+    execve(request->path, request->args, request->env);
+    request->failed = NULL;
+    request->error = errno;
+    _exit(127);
+}
+
+/* Starts the program at path the same as launch, from a clone of the shell
+ * that applies the placement before it executes, as posix_spawn cannot set
+ * a nice value or CPUs. Returns the pid of the child or -1 with errno set,
+ * storing the redirect that could not be carried out in failed. */
+pid_t spawnPlaced(const char* path, char** args, int input, int output, const Redirect* redirects, int count, const Redirect** failed) {
+    // The clone runs on its own stack until it executes, kept for the next command
+    static char* stack = NULL;
+    if (stack == NULL) {
+        stack = mmap(NULL, SPAWN_STACK_SIZE, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS|MAP_STACK, -1, 0);
+        if (stack == MAP_FAILED) {
+            stack = NULL;
+            return -1;
+        }
+    }
+
+    PlacedRequest request = {path, args, variableEnvironment(), input, output, redirects, count, 0, NULL};
+
+    // Every signal is blocked until the clone has set back the handlers of the shell
+    sigset_t all;
+    sigset_t old;
+    sigfillset(&all);
+    sigprocmask(SIG_SETMASK, &all, &old);
+    pid_t pid = clone(placedChild, stack + SPAWN_STACK_SIZE, CLONE_VM|CLONE_VFORK|SIGCHLD, &request);
+    int error = pid == -1 ? errno : request.error;
+    sigprocmask(SIG_SETMASK, &old, NULL);
+
+    // A clone that could not execute still exits as a child of the shell, which ignores it
+    if (error != 0) {
+        *failed = pid == -1 ? NULL : request.failed;
+        errno = error;
+        return -1;
+    }
+    return pid;
+}
+
+/* Finds which of the count redirects a child started with posix_spawn could
+ * not carry out, as posix_spawn only returns the error. Every redirect before
+ * the one that failed was carried out by the child, so the files are opened
+ * again in the same order, without blocking, until one fails with error.
+ * Returns that redirect, or NULL if the program itself could not be executed. */
+const Redirect* findFailedRedirect(const Redirect* redirects, int count, int error) {
+    for (int i = 0; i < count; i++) {
+        const Redirect* redirect = &redirects[i];
+
+        if (redirect->action == REDIRECT_OPEN) {
+            int fd = open(redirect->file, redirect->flags|O_CLOEXEC|O_NONBLOCK, REDIRECT_FILE_MODE);
+            if (fd == -1 && errno == error)
+                return redirect;
+            if (fd != -1)
+                close(fd);
+        } else if (redirect->action == REDIRECT_DUP && error == EBADF) {
+            // The source is open in the child if an earlier redirect opened it, otherwise if it is open in the shell
+            int valid = -1;
+            for (int j = i - 1; j >= 0 && valid == -1; j--) {
+                if (redirects[j].fd == redirect->source)
+                    valid = redirects[j].action != REDIRECT_CLOSE;
+            }
+            if (valid == -1)
+                valid = fcntl(redirect->source, F_GETFD) != -1;
+            if (!valid)
+                return redirect;
+        }
+    }
+
+    return NULL;
+}
+
+/* Starts the program at path with args as its arguments the same as launch,
+ * through the zygote, spawnPlaced or posix_spawn. Returns the pid of the
+ * child or -1 with errno set, storing the redirect that could not be carried
+ * out in failed. */
+pid_t spawnProgram(const char* path, char** args, int input, int output, const Redirect* redirects, int count, const Redirect** failed) {
+    // The helper starts the command when the shell was given --zygote
+    pid_t pid;
+    if (zygoteRunning() && zygoteLaunch(path, args, input, output, redirects, count, &pid, failed) == 0)
+        return pid;
+
+    // The nice value and CPUs of a job must be set before the command executes
+    if (placementSet())
+        return spawnPlaced(path, args, input, output, redirects, count, failed);
+
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+
+    // Sets stdin and stdout to the pipes of the pipeline
+    if (input != STDIN_FILENO) {
+        posix_spawn_file_actions_adddup2(&actions, input, STDIN_FILENO);
+        posix_spawn_file_actions_addclose(&actions, input);
+    }
+    if (output != STDOUT_FILENO) {
+        posix_spawn_file_actions_adddup2(&actions, output, STDOUT_FILENO);
+        if (output != input)
+            posix_spawn_file_actions_addclose(&actions, output);
+    }
+
+    // The redirects are carried out after, so they take the place of the pipes
+    int strings[count > 0 ? count : 1];
+    int stringCount = 0;
+    int error = 0;
+    for (int i = 0; i < count && error == 0; i++) {
+        const Redirect* redirect = &redirects[i];
+        switch (redirect->action) {
+            case REDIRECT_OPEN:
+                // The child opens the file straight onto its descriptor, so it is not made close on exec
+                posix_spawn_file_actions_addopen(&actions, redirect->fd, redirect->file, redirect->flags, REDIRECT_FILE_MODE);
+                break;
+            case REDIRECT_DUP:
+                posix_spawn_file_actions_adddup2(&actions, redirect->source, redirect->fd);
+                break;
+            case REDIRECT_CLOSE:
+                posix_spawn_file_actions_addclose(&actions, redirect->fd);
+                break;
+            default:
+                // A here-string is written by the shell and handed over as a descriptor
+                strings[stringCount] = hereString(redirect->file);
+                if (strings[stringCount] == -1) {
+                    error = errno;
+                    *failed = redirect;
+                } else
+                    posix_spawn_file_actions_adddup2(&actions, strings[stringCount++], redirect->fd);
+        }
+    }
+
+    // The shell keeps SIGCHLD blocked, the child starts with nothing blocked
+    posix_spawnattr_t attributes;
+    sigset_t mask;
+    sigemptyset(&mask);
+    posix_spawnattr_init(&attributes);
+    posix_spawnattr_setsigmask(&attributes, &mask);
+    posix_spawnattr_setflags(&attributes, POSIX_SPAWN_SETSIGMASK);
+
+    // Starts the child, glibc creates it with clone(CLONE_VM|CLONE_VFORK)
+    if (error == 0) {
+        error = posix_spawn(&pid, path, &actions, &attributes, args, variableEnvironment());
+        if (error != 0)
+            *failed = findFailedRedirect(redirects, count, error);
+    }
+    posix_spawn_file_actions_destroy(&actions);
+    posix_spawnattr_destroy(&attributes);
+
+    // The child has its own copy of every here-string by now
+    for (int i = 0; i < stringCount; i++)
+        close(strings[i]);
+
+    if (error != 0) {
+        errno = error;
+        return -1;
+    }
+    return pid;
+}
+
+/* Starts the program args[0] in a new process with args as its arguments,
+ * through the zygote when it is running. The stdin and stdout of the child
+ * are set to input and output, then the count redirects are carried out in
+ * order. Returns the pid of the child or -1 with errno set if it could not be
+ * started, with the redirect that could not be carried out stored in failed,
+ * or NULL when the program could not be found or executed. A program that
+ * is no longer where the path cache found it is looked for on PATH again. */
+pid_t launch(char** args, int input, int output, const Redirect* redirects, int count, const Redirect** failed) {
+    *failed = NULL;
+
+    // Finds the program through the path cache
+    const char* path = pathCacheLookup(args[0]);
+    if (path == NULL) {
+        errno = ENOENT;
+        return -1;
+    }
+
+    // A program removed or moved since it was cached is looked for on PATH again, the same as bash
+    pid_t pid = spawnProgram(path, args, input, output, redirects, count, failed);
+    if (pid == -1 && errno == ENOENT && *failed == NULL && strchr(args[0], '/') == NULL) {
+        char* stale = strdup(path);
+        pathCacheForget(args[0]);
+        path = pathCacheLookup(args[0]);
+
+        if (path != NULL && strcmp(path, stale) != 0)
+            pid = spawnProgram(path, args, input, output, redirects, count, failed);
+        else
+            errno = ENOENT;
+        free(stale);
+    }
+
+    return pid;
+}
+
+/* Writes text followed by a newline to a new memory file, open close on
+ * exec and read from the start. Returns its descriptor or -1 if it could
+ * not be made. */
+int hereString(const char* text) {
+    int fd = memfd_create("here-string", MFD_CLOEXEC);
+    if (fd == -1)
+        return -1;
+
+    // Written at the start without moving the offset, so it is read from the start
+    struct iovec parts[2] = {{(void*) text, strlen(text)}, {"\n", 1}};
+    if (pwritev(fd, parts, 2, 0) == -1) {
+        int error = errno;
+        close(fd);
+        errno = error;
+        return -1;
+    }
+
+    return fd;
+}
+
+/* Carries out the count redirects on the calling process in order, with
+ * every file opened close on exec until it is moved onto its descriptor.
+ * Returns 0, or -1 with errno set and the redirect that could not be
+ * carried out stored in failed. */
+int applyRedirects(const Redirect* redirects, int count, const Redirect** failed) {
+    for (int i = 0; i < count; i++) {
+        const Redirect* redirect = &redirects[i];
+        int fd = -1;
+        *failed = redirect;
+
+        if (redirect->action == REDIRECT_DUP) {
+            if (dup2(redirect->source, redirect->fd) == -1)
+                return -1;
+            continue;
+        }
+        if (redirect->action == REDIRECT_CLOSE) {
+            close(redirect->fd);
+            continue;
+        }
+
+        if (redirect->action == REDIRECT_OPEN)
+            fd = open(redirect->file, redirect->flags|O_CLOEXEC, REDIRECT_FILE_MODE);
+        else
+            fd = hereString(redirect->file);
+        if (fd == -1)
+            return -1;
+
+        // A file opened onto its own descriptor keeps it, but must still be left open by exec
+        if (fd == redirect->fd) {
+            fcntl(fd, F_SETFD, 0);
+        } else {
+            int moved = dup2(fd, redirect->fd);
+            int error = errno;
+            close(fd);
+            errno = error;
+            if (moved == -1)
+                return -1;
+        }
+    }
+
+    return 0;
+}
+
+/* Prints why the redirect failed could not be carried out, errno being set
+ * by the attempt, naming its file or the descriptor it copies. */
+void printRedirectError(const Redirect* failed) {
+    if (failed->file != NULL)
+        fprintf(stderr, "%s: %s\n", failed->action == REDIRECT_STRING ? "here-string" : failed->file, strerror(errno));
+    else
+        fprintf(stderr, "%d: %s\n", failed->source, strerror(errno));
+}
+
+/* Points stdin and stdout of the calling process at input and output, then
+ * carries out the count redirects. Used by builtins, which run without
+ * executing a program.
+ * Returns -1 after printing a message if a redirect could not be carried out. */
+int redirectStandard(int input, int output, const Redirect* redirects, int count) {
+    uint64_t start = traceClock();
+
+    if (input != STDIN_FILENO)
+        dup2(input, STDIN_FILENO);
+    if (output != STDOUT_FILENO)
+        dup2(output, STDOUT_FILENO);
+
+    const Redirect* failed;
+    if (applyRedirects(redirects, count, &failed) == -1) {
+        printRedirectError(failed);
+        return -1;
+    }
+
+    traceSpan("open", start, NULL, 0);
+    return 0;
+}
@@ -0,0 +1,84 @@
+/* Benjamin Schroeder
+ *
+ * launch.h
+ *
+ * The header file for the launcher used to start commands that do not need
+ * a copy of the shell. Commands are started with posix_spawn, which creates
+ * the child without duplicating the shell's memory, so the cost of starting
+ * a command stays the same no matter how large the shell has grown. The
+ * redirects of the command, resolved into changes to its descriptors when
+ * it was parsed, become spawn file actions so nothing has to run inside the
+ * child before the command is executed. The stages of a job with a nice
+ * value or CPUs are started from a clone of the shell that sets them first.
+ */
+
+#ifndef CS352P1_LAUNCH_H
+#define CS352P1_LAUNCH_H
+
+#include "parser.h"
+#include <sched.h>
+#include <sys/types.h>
+
+/* The nice value and CPUs commands are started with, applied in each child
+ * before it executes so nothing it starts runs without them. */
+typedef struct Placement {
+    int nice;
+    int pinned;
+    cpu_set_t cpus;
+    /* The error of the last child that could not set its nice value or CPUs, or 0. */
+    int niceError;
+    int cpusError;
+} Placement;
+
+/* The placement of the commands being started, cleared outside of starting a job. */
+extern Placement placement;
+
+/* Has every command started from now on run with the given nice value and,
+ * unless cpus is NULL, only on cpus. Clears the errors of the last placement. */
+void setPlacement(int nice, const cpu_set_t* cpus);
+
+/* Returns 1 if commands are being started with a nice value or CPUs. */
+int placementSet();
+
+/* Applies a placement to the calling process, recording the error of each
+ * setting that could not be applied in it. */
+void applyPlacement(Placement* placement);
+
+/* Finds which of the count redirects a child started with posix_spawn could
+ * not carry out, as posix_spawn only returns the error. Every redirect before
+ * the one that failed was carried out by the child, so the files are opened
+ * again in the same order, without blocking, until one fails with error.
+ * Returns that redirect, or NULL if the program itself could not be executed. */
+const Redirect* findFailedRedirect(const Redirect* redirects, int count, int error);
+
+/* Starts the program args[0] in a new process with args as its arguments,
+ * through the zygote when it is running. The stdin and stdout of the child
+ * are set to input and output, then the count redirects are carried out in
+ * order. Returns the pid of the child or -1 with errno set if it could not be
+ * started, with the redirect that could not be carried out stored in failed,
+ * or NULL when the program could not be found or executed. A program that
+ * is no longer where the path cache found it is looked for on PATH again. */
+pid_t launch(char** args, int input, int output, const Redirect* redirects, int count, const Redirect** failed);
+
+/* Writes text followed by a newline to a new memory file, open close on
+ * exec and read from the start. Returns its descriptor or -1 if it could
+ * not be made. */
+int hereString(const char* text);
+
+/* Carries out the count redirects on the calling process in order, with
+ * every file opened close on exec until it is moved onto its descriptor.
+ * Returns 0, or -1 with errno set and the redirect that could not be
+ * carried out stored in failed. */
+int applyRedirects(const Redirect* redirects, int count, const Redirect** failed);
+
+/* Prints why the redirect failed could not be carried out, errno being set
+ * by the attempt, naming its file or the descriptor it copies. */
+void printRedirectError(const Redirect* failed);
+
+/* Points stdin and stdout of the calling process at input and output, then
+ * carries out the count redirects. Used by builtins, which run without
+ * executing a program.
+ * Returns -1 after printing a message if a redirect could not be carried out. */
+int redirectStandard(int input, int output, const Redirect* redirects, int count);
+
+#endif //CS352P1_LAUNCH_H
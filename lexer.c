@@ -0,0 +1,360 @@
+/* Benjamin Schroeder
+ *
+ * lexer.c
+ *
+ * The implementation of the lexer used to break command lines into words and
+ * operators. The text is read once from left to right, operators are
+ * recognized whether or not they are surrounded by spaces and quotes or a
+ * backslash can be used to remove the special meaning of a character. A
+ * newline is an operator of its own so text of many lines can be lexed at
+ * once, and a backslash at the end of a line joins it to the next. A number
+ * written right before a redirect operator, as in 2>&1, is kept with the
+ * operator as the descriptor it changes. The text of every word is written
+ * to a single buffer, with the name of each $NAME or ${NAME} outside single
+ * quotes written between marks so the variable can be expanded every time
+ * the word is run, the text of each $(...) or `...` command written between
+ * marks the same way so it is run every time, and a mark before every
+ * unquoted '*', '?' and '[' so only those are matched against file names.
+ * An unquoted '#' starting a word comments out the rest of its line.
+ */
+
+#include "lexer.h"
+#include "shellVariables.h"
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Adds a token to the end of the token list, growing it when full. */
+void addToken(Lexer* lex, char op, int offset, int start) {
+    if (lex->tokenCount == lex->tokenCapacity) {
+        lex->tokenCapacity = lex->tokenCapacity == 0 ? 64 : lex->tokenCapacity * 2;
+        lex->tokens = (Token*) realloc(lex->tokens, sizeof(Token) * lex->tokenCapacity);
+    }
+
+    Token* token = &lex->tokens[lex->tokenCount++];
+    token->op = op;
+    token->offset = offset;
+    token->start = start;
+    token->end = start + 1;
+    token->expand = 0;
+    token->fd = -1;
+}
+
+/* Returns the redirect operator starting at line[i], or 0 if there is
+ * none, storing how many characters it takes in width. */
+char redirectOperator(const char* line, size_t i, int* width) {
+    const char* c = line + i;
+    *width = 2;
+
+    if (c[0] == '<' && c[1] == '<' && c[2] == '<') {
+        *width = 3;
+        return HERE_STRING_OP;
+    }
+    if (c[0] == '&' && c[1] == '>') {
+        *width = c[2] == '>' ? 3 : 2;
+        return c[2] == '>' ? ALL_APPEND_OP : ALL_OUT_OP;
+    }
+    if (c[0] == '<' && c[1] == '&')
+        return DUP_IN_OP;
+    if (c[0] == '<' && c[1] == '>')
+        return READ_WRITE_OP;
+    if (c[0] == '>' && c[1] == '>')
+        return APPEND_OP;
+    if (c[0] == '>' && c[1] == '&')
+        return DUP_OUT_OP;
+    if (c[0] == '>' && c[1] == '|')
+        return REDIRECT_OUT_OP;
+
+    *width = 1;
+    return c[0] == '<' || c[0] == '>' ? c[0] : 0;
+}
+
+/* Returns 1 if the length characters at text are all digits, so a word
+ * made of them right before a redirect names the descriptor it changes. */
+int isDescriptor(const char* text, size_t length) {
+    for (size_t i = 0; i < length; i++) {
+        if (!isdigit((unsigned char) text[i]))
+            return 0;
+    }
+    return length > 0 && length < 4;
+}
+
+/* Returns 1 if c is a character that is an operator on its own. */
+int isOperator(char c) {
+    return c == REDIRECT_IN_OP || c == REDIRECT_OUT_OP || c == PIPE_OP || c == BG_OP
+           || c == SEQ_OP || c == NEWLINE_OP;
+}
+
+/* Reads the variable named after the '$' at line[i], given as $NAME,
+ * ${NAME} or one of the special $? and $$. Writes its name between marks
+ * to the text of the current word, quoted if it is inside double quotes.
+ * Returns how many characters after the '$' were read, or 0 if the '$' does
+ * not start a variable and is an ordinary character. */
+int lexVariable(Lexer* lex, const char* line, size_t i, int quoted) {
+    const char* name = line + i + 1;
+    int braced = name[0] == '{';
+    if (braced)
+        name++;
+
+    int length = 0;
+    if (name[0] == '?' || name[0] == '$' || isdigit((unsigned char) name[0])) {
+        length = 1;
+    } else if (name[0] == '_' || isalpha((unsigned char) name[0])) {
+        while (name[length] == '_' || isalnum((unsigned char) name[length]))
+            length++;
+    }
+
+    if (length == 0 || (braced && name[length] != '}'))
+        return 0;
+
+    lex->text[lex->textLength++] = quoted ? QUOTED_EXPAND_MARK : EXPAND_MARK;
+    memcpy(lex->text + lex->textLength, name, length);
+    lex->textLength += length;
+    lex->text[lex->textLength++] = EXPAND_END;
+    lex->tokens[lex->tokenCount - 1].expand = 1;
+
+    return length + (braced ? 2 : 0);
+}
+
+/* Returns the index of the ')' closing the $( that starts at line[i], with
+ * quotes and nested parentheses skipped, or -1 if it is not closed. */
+long closingParenthesis(const char* line, size_t length, size_t i) {
+    int depth = 1;
+
+    for (size_t j = i + 2; j < length; j++) {
+        char c = line[j];
+        if (c == '\\') {
+            j++;
+        } else if (c == '\'' || c == '"') {
+            // Parentheses inside quotes do not count, a double quote can still hold escaped quotes
+            for (j++; j < length && line[j] != c; j++) {
+                if (c == '"' && line[j] == '\\')
+                    j++;
+            }
+        } else if (c == '(') {
+            depth++;
+        } else if (c == ')' && --depth == 0) {
+            return (long) j;
+        }
+    }
+
+    return -1;
+}
+
+/* Reads the command substituted by the $(...) or `...` starting at line[i]
+ * and writes its text between marks to the current word, quoted if it is
+ * inside double quotes, so it is run each time the word is expanded. A
+ * backslash before '`', '\\' or '$' inside backquotes is removed. Returns how
+ * many characters after the first were read, 0 if a '$' does not start a
+ * substitution or -1 if the substitution is not closed. */
+long lexSubstitution(Lexer* lex, const char* line, size_t length, size_t i, int quoted) {
+    size_t start;
+    long end;
+
+    if (line[i] == '`') {
+        start = i + 1;
+        for (end = (long) start; end < (long) length && line[end] != '`'; end++) {
+            if (line[end] == '\\')
+                end++;
+        }
+        if (end >= (long) length)
+            return -1;
+    } else {
+        if (line[i + 1] != '(')
+            return 0;
+        start = i + 2;
+        end = closingParenthesis(line, length, i);
+        if (end == -1)
+            return -1;
+    }
+
+    lex->text[lex->textLength++] = quoted ? QUOTED_SUBSTITUTE_MARK : SUBSTITUTE_MARK;
+    for (size_t j = start; j < (size_t) end; j++) {
+        if (line[i] == '`' && line[j] == '\\' && (line[j + 1] == '`' || line[j + 1] == '\\' || line[j + 1] == '$'))
+            j++;
+        lex->text[lex->textLength++] = line[j];
+    }
+    lex->text[lex->textLength++] = EXPAND_END;
+    lex->tokens[lex->tokenCount - 1].expand = 1;
+
+    return end - (long) i;
+}
+
+/* Splits the null terminated text into words and operators in a single pass,
+ * with every newline given a token of its own.
+ * Returns 0 on success or -1 if a quote or substitution is left open or the
+ * text ends with a backslash joining it to a line that has not been given
+ * yet. */
+int lexLine(Lexer* lex, const char* line) {
+    size_t length = strlen(line);
+
+    // The words with their terminators and the marks around variables take at most twice the text
+    if (lex->textCapacity < (int) (length * 2 + 1)) {
+        lex->textCapacity = (int) (length * 2 + 1);
+        lex->text = (char*) realloc(lex->text, lex->textCapacity);
+    }
+
+    lex->tokenCount = 0;
+    lex->textLength = 0;
+
+    // Set while the characters being read belong to a word
+    int inWord = 0;
+    // The quote character that is currently open, or 0
+    char quote = 0;
+    // Set if the last line ends with a backslash
+    int joined = 0;
+
+    for (size_t i = 0; i < length; i++) {
+        char c = line[i];
+
+        // Inside quotes everything is part of the word until the closing quote
+        if (quote != 0) {
+            int skipped;
+            long substituted;
+            if (c == quote) {
+                quote = 0;
+            } else if (quote == '"' && c == '\\' && i + 1 < length
+                       && (line[i + 1] == '"' || line[i + 1] == '\\' || line[i + 1] == '$' || line[i + 1] == '`')) {
+                lex->text[lex->textLength++] = line[++i];
+            } else if (quote == '"' && (c == '$' || c == '`') && (substituted = lexSubstitution(lex, line, length, i, 1)) != 0) {
+                if (substituted == -1)
+                    return -1;
+                i += substituted;
+            } else if (quote == '"' && c == '$' && (skipped = lexVariable(lex, line, i, 1)) > 0) {
+                i += skipped;
+            } else {
+                lex->text[lex->textLength++] = c;
+            }
+            continue;
+        }
+
+        // A backslash at the end of a line joins it to the next as if neither were there
+        if (c == '\\' && i + 1 < length && line[i + 1] == '\n') {
+            joined = ++i + 1 == length;
+            continue;
+        }
+
+        // Spaces and operators end the current word
+        if (c == ' ' || c == '\t' || isOperator(c)) {
+            // A number right before a redirect is the descriptor it changes rather than a word
+            int fd = -1;
+            int wordStart = -1;
+            if (inWord && (c == REDIRECT_IN_OP || c == REDIRECT_OUT_OP)) {
+                Token* word = &lex->tokens[lex->tokenCount - 1];
+                if (isDescriptor(line + word->start, i - word->start)) {
+                    fd = atoi(line + word->start);
+                    wordStart = word->start;
+                    lex->textLength = word->offset;
+                    lex->tokenCount--;
+                    inWord = 0;
+                }
+            }
+
+            if (inWord) {
+                lex->text[lex->textLength++] = '\0';
+                lex->tokens[lex->tokenCount - 1].end = (int) i;
+                inWord = 0;
+            }
+
+            if (c == ' ' || c == '\t')
+                continue;
+
+            // A doubled '&' or '|' is the operator joining two commands
+            int width;
+            char redirect = redirectOperator(line, i, &width);
+            if ((c == BG_OP || c == PIPE_OP) && i + 1 < length && line[i + 1] == c) {
+                addToken(lex, c == BG_OP ? AND_OP : OR_OP, -1, (int) i);
+                lex->tokens[lex->tokenCount - 1].end = (int) (++i + 1);
+            } else if (redirect != 0) {
+                addToken(lex, redirect, -1, wordStart != -1 ? wordStart : (int) i);
+                lex->tokens[lex->tokenCount - 1].fd = fd;
+                lex->tokens[lex->tokenCount - 1].end = (int) (i + width);
+                i += width - 1;
+            } else {
+                addToken(lex, c, -1, (int) i);
+            }
+            continue;
+        }
+
+        // A '#' starting a word comments out the rest of the line, which skips a '#!' line as well
+        if (!inWord && c == '#') {
+            while (i + 1 < length && line[i + 1] != '\n')
+                i++;
+            continue;
+        }
+
+        // Any other character starts a word if one is not already started
+        if (!inWord) {
+            addToken(lex, 0, lex->textLength, (int) i);
+            inWord = 1;
+        }
+
+        int skipped;
+        long substituted;
+        if (c == '\'' || c == '"') {
+            quote = c;
+        } else if ((c == '$' || c == '`') && (substituted = lexSubstitution(lex, line, length, i, 0)) != 0) {
+            // A substitution left open is finished by the lines that follow
+            if (substituted == -1)
+                return -1;
+            i += substituted;
+        } else if (c == '$' && (skipped = lexVariable(lex, line, i, 0)) > 0) {
+            i += skipped;
+        } else if (c == '*' || c == '?' || c == '[') {
+            // Characters matching file names are marked so quoted ones are left alone
+            lex->text[lex->textLength++] = PATTERN_MARK;
+            lex->text[lex->textLength++] = c;
+            lex->tokens[lex->tokenCount - 1].expand = 1;
+        } else if (c == '\\' && i + 1 < length) {
+            lex->text[lex->textLength++] = line[++i];
+        } else {
+            lex->text[lex->textLength++] = c;
+        }
+    }
+
+    if (inWord) {
+        lex->text[lex->textLength++] = '\0';
+        lex->tokens[lex->tokenCount - 1].end = (int) length;
+    }
+
+    return quote == 0 && !joined ? 0 : -1;
+}
+
+/* Returns the text of a token as it would be written in a command, used to
+ * point out where a syntax error is. */
+const char* tokenText(const Lexer* lex, const Token* token) {
+    switch (token->op) {
+        case 0:
+            return lex->text + token->offset;
+        case AND_OP:
+            return "&&";
+        case OR_OP:
+            return "||";
+        case NEWLINE_OP:
+            return "newline";
+        case REDIRECT_IN_OP:
+            return "<";
+        case REDIRECT_OUT_OP:
+            return ">";
+        case APPEND_OP:
+            return ">>";
+        case READ_WRITE_OP:
+            return "<>";
+        case DUP_OUT_OP:
+            return ">&";
+        case DUP_IN_OP:
+            return "<&";
+        case ALL_OUT_OP:
+            return "&>";
+        case ALL_APPEND_OP:
+            return "&>>";
+        case HERE_STRING_OP:
+            return "<<<";
+        case PIPE_OP:
+            return "|";
+        case BG_OP:
+            return "&";
+        default:
+            return ";";
+    }
+}
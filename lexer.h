@@ -0,0 +1,63 @@
+/* Benjamin Schroeder
+ *
+ * lexer.h
+ *
+ * The header file for the lexer used to break command lines into words and
+ * operators. The text is read once from left to right, operators are
+ * recognized whether or not they are surrounded by spaces and quotes or a
+ * backslash can be used to remove the special meaning of a character. A
+ * newline is an operator of its own so text of many lines can be lexed at
+ * once, and a backslash at the end of a line joins it to the next. A number
+ * written right before a redirect operator, as in 2>&1, is kept with the
+ * operator as the descriptor it changes. The text of every word is written
+ * to a single buffer, with the name of each $NAME or ${NAME} outside single
+ * quotes written between marks so the variable can be expanded every time
+ * the word is run, the text of each $(...) or `...` command written between
+ * marks the same way so it is run every time, and a mark before every
+ * unquoted '*', '?' and '[' so only those are matched against file names.
+ * An unquoted '#' starting a word comments out the rest of its line.
+ */
+
+#ifndef CS352P1_LEXER_H
+#define CS352P1_LEXER_H
+
+/* A single word or operator of a command line. */
+typedef struct Token {
+    /* The operator character of the token, or 0 if the token is a word. */
+    char op;
+    /* Where the text of a word starts in the lexer's text buffer. */
+    int offset;
+    /* Where the token starts and ends in the text that was lexed. */
+    int start;
+    int end;
+    /* Set if the word holds variables, substitutions or patterns to be expanded when it is run. */
+    char expand;
+    /* The descriptor written right before a redirect operator, as in 2>, or -1. */
+    int fd;
+} Token;
+
+/* Holds the tokens of the most recently lexed text. The buffers are kept
+ * between lines and are only ever grown. */
+typedef struct Lexer {
+    /* The tokens of the line in order. */
+    Token *tokens;
+    int tokenCount;
+    int tokenCapacity;
+    /* The null terminated text of every word placed one after another. */
+    char *text;
+    int textLength;
+    int textCapacity;
+} Lexer;
+
+/* Splits the null terminated text into words and operators in a single pass,
+ * with every newline given a token of its own.
+ * Returns 0 on success or -1 if a quote or substitution is left open or the
+ * text ends with a backslash joining it to a line that has not been given
+ * yet. */
+int lexLine(Lexer* lex, const char* line);
+
+/* Returns the text of a token as it would be written in a command, used to
+ * point out where a syntax error is. */
+const char* tokenText(const Lexer* lex, const Token* token);
+
+#endif //CS352P1_LEXER_H
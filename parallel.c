@@ -0,0 +1,223 @@
+/* Benjamin Schroeder
+ *
+ * parallel.c
+ *
+ * The implementation of the parallel builtin, which runs many commands while
+ * keeping a fixed number of them running at once. Every task is started as
+ * a held job in the job table with its output captured in a memory file the
+ * same as a background job, so the reaper and process id map find the tasks
+ * that finish and free slots are refilled right away. The output of each
+ * task is printed once it finishes, either as tasks complete or in the order
+ * they were given, and every task that fails is reported with its exit code.
+ */
+
+#define _GNU_SOURCE
+
+#include "parallel.h"
+#include "processList.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <wait.h>
+#include <sys/mman.h>
+
+/* Writes the command line of a task into line. The input takes the place of
+ * every '{}' in command, or is added to the end when there is none, and is
+ * the whole line when there is no command. Returns the length of the line. */
+size_t taskLine(char** line, size_t* capacity, char** command, const char* input) {
+    size_t used = 0;
+
+    if (command[0] == NULL) {
+        appendText(line, &used, capacity, input, strlen(input));
+        appendText(line, &used, capacity, "\n", 1);
+        return used;
+    }
+
+    char* arg = NULL;
+    size_t argCapacity = 0;
+    int replaced = 0;
+
+    for (int i = 0; command[i] != NULL; i++) {
+        // Builds the argument with the input in place of every '{}'
+        size_t argUsed = 0;
+        const char* part = command[i];
+        for (const char* braces; (braces = strstr(part, "{}")) != NULL; part = braces + 2) {
+            appendText(&arg, &argUsed, &argCapacity, part, braces - part);
+            appendText(&arg, &argUsed, &argCapacity, input, strlen(input));
+            replaced = 1;
+        }
+        appendText(&arg, &argUsed, &argCapacity, part, strlen(part));
+
+        appendQuoted(line, &used, capacity, arg);
+    }
+
+    if (!replaced)
+        appendQuoted(line, &used, capacity, input);
+
+    free(arg);
+    appendText(line, &used, capacity, "\n", 1);
+    return used;
+}
+
+/* Reads all of stdin and splits it into lines, which are stored in a newly
+ * allocated NULL terminated array. The descriptor is read directly as stdin
+ * may have been replaced underneath the shell's own buffer. */
+char** readLines(char** text) {
+    size_t used = 0;
+    size_t capacity = 0;
+    char chunk[65536];
+    ssize_t length;
+
+    *text = NULL;
+    appendText(text, &used, &capacity, "", 0);
+    while ((length = read(STDIN_FILENO, chunk, sizeof(chunk))) > 0)
+        appendText(text, &used, &capacity, chunk, length);
+
+    size_t count = 0;
+    for (size_t i = 0; i < used; i++) {
+        if ((*text)[i] == '\n')
+            count++;
+    }
+
+    char** lines = (char**) malloc(sizeof(char*) * (count + 2));
+    count = 0;
+    for (char* line = strtok(*text, "\n"); line != NULL; line = strtok(NULL, "\n"))
+        lines[count++] = line;
+    lines[count] = NULL;
+
+    return lines;
+}
+
+/* Prints the output of a finished task, reports it if it failed and
+ * removes it from the table. Returns 1 if it failed. */
+int finishTask(Job* task) {
+    int status = task->cmd->statuses[task->cmd->stageCount - 1];
+    int failed = !WIFEXITED(status) || WEXITSTATUS(status) != 0;
+
+    printOutput(task);
+    task->file = STDOUT_FILENO;
+
+    if (failed) {
+        fflush(stdout);
+        fprintf(stderr, "parallel: exit %d: %s", exitCode(status), task->cmd->line);
+    }
+
+    removeProcess(task);
+    return failed;
+}
+
+/* Runs a task for every argument after ':::', or every line of stdin when
+ * there is no ':::', keeping at most -j tasks running at once, by default
+ * one per online CPU. A task is the command given with the argument put in
+ * place of each '{}' or added to the end, or the line itself when there is
+ * no command. Output is printed in the order tasks were given with -k.
+ * Returns the number of tasks that failed, at most 101. */
+int builtinParallel(char** args) {
+    int slots = (int) sysconf(_SC_NPROCESSORS_ONLN);
+    int keepOrder = 0;
+    int i = 1;
+
+    for (; args[i] != NULL && args[i][0] == '-'; i++) {
+        if (strcmp(args[i], "-k") == 0) {
+            keepOrder = 1;
+        } else if (strcmp(args[i], "-j") == 0 && args[i + 1] != NULL && atoi(args[i + 1]) > 0) {
+            slots = atoi(args[++i]);
+        } else {
+            fprintf(stderr, "usage: parallel [-j jobs] [-k] [command...] [::: arguments...]\n");
+            return 1;
+        }
+    }
+
+    // The command ends at ':::', the inputs are the arguments after it or the lines of stdin
+    char** command = &args[i];
+    char** inputs = NULL;
+    char* text = NULL;
+    for (; args[i] != NULL; i++) {
+        if (strcmp(args[i], ":::") == 0) {
+            args[i] = NULL;
+            inputs = &args[i + 1];
+            break;
+        }
+    }
+    char** lines = inputs == NULL ? readLines(&text) : NULL;
+    if (inputs == NULL)
+        inputs = lines;
+
+    int count = 0;
+    while (inputs[count] != NULL)
+        count++;
+
+    // The task started for each input, NULL once it has been finished
+    Job** tasks = (Job**) calloc(count > 0 ? count : 1, sizeof(Job*));
+    // Set for a task that has exited but is waiting for its turn to be printed with -k
+    char* exited = (char*) calloc(count > 0 ? count : 1, 1);
+    // The tasks still running, so a wakeup only checks those rather than every task not yet printed
+    int* active = (int*) malloc(sizeof(int) * (count > 0 ? count : 1));
+    char* line = NULL;
+    size_t lineCapacity = 0;
+    int started = 0;
+    int running = 0;
+    int printed = 0;
+    int failed = 0;
+
+    while (printed < count) {
+        // Fills every free slot with the next task
+        while (running < slots && started < count) {
+            Cmd* cmd = newCmd();
+            size_t length = taskLine(&line, &lineCapacity, command, inputs[started]);
+            int output = memfd_create("tmp", MFD_CLOEXEC);
+
+            if (parseCmd(cmd, line, length) == -1 || cmd->pipeline->stageCount == 0
+                || cmd->pipeline->background || startPipeline(cmd, STDIN_FILENO, output) == -1) {
+                // A task that cannot be started is finished right away as failed
+                fprintf(stderr, "parallel: could not start: %s", line);
+                freeCmd(cmd);
+                close(output);
+                failed++;
+            } else {
+                tasks[started] = newProcess(cmd, output, 0);
+                tasks[started]->held = 1;
+                addProcess(tasks[started]);
+                active[running++] = started;
+            }
+            started++;
+        }
+
+        // A task frees its slot as soon as it exits, only its output waits for its turn with -k
+        for (int j = 0; j < running; j++) {
+            int task = active[j];
+            if (runningStages(tasks[task]->cmd) != 0)
+                continue;
+
+            active[j--] = active[--running];
+            if (keepOrder) {
+                exited[task] = 1;
+            } else {
+                failed += finishTask(tasks[task]);
+                tasks[task] = NULL;
+            }
+        }
+
+        // Tasks are printed in the order given once every one before them has been
+        while (printed < started && (tasks[printed] == NULL || exited[printed])) {
+            if (tasks[printed] != NULL)
+                failed += finishTask(tasks[printed]);
+            tasks[printed++] = NULL;
+        }
+
+        if (printed < count && (running == slots || started == count)) {
+            waitForChange();
+            checkProcessStatus(NULL);
+        }
+    }
+
+    fflush(stdout);
+    free(tasks);
+    free(exited);
+    free(active);
+    free(line);
+    free(lines);
+    free(text);
+    return failed > 101 ? 101 : failed;
+}
@@ -0,0 +1,27 @@
+/* Benjamin Schroeder
+ *
+ * parallel.h
+ *
+ * The header file for the parallel builtin, which runs many commands while
+ * keeping a fixed number of them running at once. Every task is started as
+ * a held job in the job table with its output captured in a memory file the
+ * same as a background job, so the reaper and process id map find the tasks
+ * that finish and free slots are refilled right away. The output of each
+ * task is printed once it finishes, either as tasks complete or in the order
+ * they were given, and every task that fails is reported with its exit code.
+ *
+ * Usage: parallel [-j jobs] [-k] [command...] [::: arguments...]
+ */
+
+#ifndef CS352P1_PARALLEL_H
+#define CS352P1_PARALLEL_H
+
+/* Runs a task for every argument after ':::', or every line of stdin when
+ * there is no ':::', keeping at most -j tasks running at once, by default
+ * one per online CPU. A task is the command given with the argument put in
+ * place of each '{}' or added to the end, or the line itself when there is
+ * no command. Output is printed in the order tasks were given with -k.
+ * Returns the number of tasks that failed, at most 101. */
+int builtinParallel(char** args);
+
+#endif //CS352P1_PARALLEL_H
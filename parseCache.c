@@ -0,0 +1,142 @@
+/* Benjamin Schroeder
+ *
+ * parseCache.c
+ *
+ * The implementation of the cache of parsed lines. Scripts and loops tend to
+ * run the same few lines over and over, so the plan of every line that
+ * compiles is kept, keyed by a hash of the raw text, and text seen before
+ * shares the cached plan instead of being lexed and parsed again. The
+ * cache holds a fixed number of plans and lets go of the least recently
+ * used one when it is full. Hits, misses and evictions are counted in the
+ * stats.
+ */
+
+#include "parseCache.h"
+#include "stats.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Every entry the cache can hold, the first cacheUsed are in use
+CacheEntry cacheEntries[PARSE_CACHE_SIZE];
+int cacheUsed = 0;
+
+// The first entry of each bucket plus one, or 0 for an empty bucket
+int cacheBuckets[PARSE_CACHE_BUCKETS];
+
+// The ends of the list of entries from most to least recently used
+int newestEntry = -1;
+int oldestEntry = -1;
+
+/* Returns the 64 bit FNV-1a hash of the length bytes of line. */
+uint64_t hashLine(const char* line, size_t length) {
+    uint64_t hash = 14695981039346656037UL;
+    for (size_t i = 0; i < length; i++) {
+        hash ^= (unsigned char) line[i];
+        hash *= 1099511628211UL;
+    }
+    return hash;
+}
+
+/* Takes an entry out of the list of recently used entries. */
+void unlinkEntry(int index) {
+    CacheEntry* entry = &cacheEntries[index];
+
+    if (entry->newer != -1)
+        cacheEntries[entry->newer].older = entry->older;
+    else
+        newestEntry = entry->older;
+
+    if (entry->older != -1)
+        cacheEntries[entry->older].newer = entry->newer;
+    else
+        oldestEntry = entry->newer;
+}
+
+/* Puts an entry at the front of the list of recently used entries. */
+void pushEntry(int index) {
+    CacheEntry* entry = &cacheEntries[index];
+
+    entry->newer = -1;
+    entry->older = newestEntry;
+    if (newestEntry != -1)
+        cacheEntries[newestEntry].newer = index;
+    newestEntry = index;
+    if (oldestEntry == -1)
+        oldestEntry = index;
+}
+
+/* Returns the plan cached for the length bytes of line, held until it is
+ * given to releasePlan, or NULL if the line is not cached. */
+Plan* cachedPlan(const char* line, size_t length) {
+    // Lines too long to be cached are not hashed
+    if (length <= PARSE_CACHE_LINE_LIMIT) {
+        uint64_t hash = hashLine(line, length);
+
+        for (int i = cacheBuckets[hash % PARSE_CACHE_BUCKETS]; i != 0; i = cacheEntries[i - 1].chain) {
+            CacheEntry* entry = &cacheEntries[i - 1];
+            if (entry->hash != hash || entry->length != length || memcmp(entry->line, line, length) != 0)
+                continue;
+
+            // The line is now the most recently used
+            if (newestEntry != i - 1) {
+                unlinkEntry(i - 1);
+                pushEntry(i - 1);
+            }
+
+            stats.parseHits++;
+            entry->plan->users++;
+            return entry->plan;
+        }
+    }
+
+    stats.parseMisses++;
+    return NULL;
+}
+
+/* Removes the least recently used entry from its bucket and the list.
+ * Returns its index so it can be reused. */
+int evictEntry() {
+    int index = oldestEntry;
+    CacheEntry* entry = &cacheEntries[index];
+
+    // Finds the link pointing at the entry within its bucket
+    int* link = &cacheBuckets[entry->hash % PARSE_CACHE_BUCKETS];
+    while (*link != index + 1)
+        link = &cacheEntries[*link - 1].chain;
+    *link = entry->chain;
+
+    unlinkEntry(index);
+    releasePlan(entry->plan);
+    entry->plan = NULL;
+    stats.parseEvictions++;
+    return index;
+}
+
+/* Caches plan for the length bytes of line, holding it until it is replaced.
+ * The least recently used plan is let go when the cache is full. Lines
+ * longer than PARSE_CACHE_LINE_LIMIT are not cached. */
+void cachePlan(const char* line, size_t length, Plan* plan) {
+    if (length > PARSE_CACHE_LINE_LIMIT)
+        return;
+
+    int index = cacheUsed < PARSE_CACHE_SIZE ? cacheUsed++ : evictEntry();
+    CacheEntry* entry = &cacheEntries[index];
+
+    // The copy of an evicted line is reused when it is large enough
+    if (length > entry->capacity) {
+        free(entry->line);
+        entry->line = malloc(length);
+        entry->capacity = length;
+    }
+
+    entry->hash = hashLine(line, length);
+    entry->plan = plan;
+    entry->length = length;
+    memcpy(entry->line, line, length);
+    plan->users++;
+
+    int* bucket = &cacheBuckets[entry->hash % PARSE_CACHE_BUCKETS];
+    entry->chain = *bucket;
+    *bucket = index + 1;
+    pushEntry(index);
+}
@@ -0,0 +1,45 @@
+/* Benjamin Schroeder
+ *
+ * parseCache.h
+ *
+ * The header file for the cache of parsed lines. Scripts and loops tend to
+ * run the same few lines over and over, so the plan of every line that
+ * compiles is kept, keyed by a hash of the raw text, and text seen before
+ * shares the cached plan instead of being lexed and parsed again. The
+ * cache holds a fixed number of plans and lets go of the least recently
+ * used one when it is full. Hits, misses and evictions are counted in the
+ * stats.
+ */
+
+#ifndef CS352P1_PARSECACHE_H
+#define CS352P1_PARSECACHE_H
+
+#include "shellVariables.h"
+#include "plan.h"
+#include <stdint.h>
+
+/* A cached plan along with the text it was compiled from. */
+typedef struct CacheEntry {
+    uint64_t hash;
+    Plan* plan;
+    /* A copy of the text, kept when the entry is reused if large enough. */
+    char* line;
+    size_t length;
+    size_t capacity;
+    /* The entries used just before and after this one, or -1. */
+    int newer;
+    int older;
+    /* The next entry in the same bucket plus one, or 0 at the end. */
+    int chain;
+} CacheEntry;
+
+/* Returns the plan cached for the length bytes of line, held until it is
+ * given to releasePlan, or NULL if the line is not cached. */
+Plan* cachedPlan(const char* line, size_t length);
+
+/* Caches plan for the length bytes of line, holding it until it is replaced.
+ * The least recently used plan is let go when the cache is full. Lines
+ * longer than PARSE_CACHE_LINE_LIMIT are not cached. */
+void cachePlan(const char* line, size_t length, Plan* plan);
+
+#endif //CS352P1_PARSECACHE_H
@@ -0,0 +1,280 @@
+/* Benjamin Schroeder
+ *
+ * parser.c
+ *
+ * The implementation of the parser used to turn a pipeline into a parse
+ * tree. The tokens produced by the lexer are read once and arranged into a
+ * pipeline made up of stages, each holding its arguments and the changes
+ * its redirects make to its descriptors. The whole tree, including the
+ * text of every word, is held in a single allocation so it can be copied
+ * and moved as one block.
+ */
+
+#include "parser.h"
+#include "lexer.h"
+#include "shellVariables.h"
+#include "trace.h"
+#include <ctype.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// The lexer is kept between lines so its buffers are reused
+Lexer lexer;
+
+/* Returns 1 if op is one of the redirect operators. */
+int isRedirectOperator(char op) {
+    return op == REDIRECT_IN_OP || op == REDIRECT_OUT_OP || op == APPEND_OP || op == READ_WRITE_OP
+           || op == DUP_OUT_OP || op == DUP_IN_OP || op == ALL_OUT_OP || op == ALL_APPEND_OP
+           || op == HERE_STRING_OP;
+}
+
+/* Returns 1 if word is a descriptor number, with no marks or quotes. */
+int isNumber(const char* word) {
+    for (const char* c = word; *c != '\0'; c++) {
+        if (!isdigit((unsigned char) *c))
+            return 0;
+    }
+    return word[0] != '\0';
+}
+
+/* Resolves the redirect operator of token, applied to word, into the
+ * changes it makes to descriptors, written to redirects. '&>' and '&>>'
+ * open the file on stdout and copy it to stderr. Returns the number of
+ * changes written, or 0 if word cannot be used with the operator. */
+int resolveRedirect(const Token* token, char* word, Redirect* redirects) {
+    char op = token->op;
+    int input = op == REDIRECT_IN_OP || op == DUP_IN_OP || op == READ_WRITE_OP || op == HERE_STRING_OP;
+    Redirect* redirect = &redirects[0];
+
+    redirect->fd = token->fd != -1 ? token->fd : (input ? 0 : 1);
+    redirect->flags = 0;
+    redirect->source = -1;
+    redirect->file = word;
+
+    // A copied descriptor is written as a number, '-' closes it and '>&file' without a number is '&>file'
+    if (op == DUP_OUT_OP || op == DUP_IN_OP) {
+        if (isNumber(word)) {
+            redirect->action = REDIRECT_DUP;
+            redirect->source = atoi(word);
+            redirect->file = NULL;
+            return 1;
+        }
+        if (strcmp(word, "-") == 0) {
+            redirect->action = REDIRECT_CLOSE;
+            redirect->file = NULL;
+            return 1;
+        }
+        if (op == DUP_IN_OP || token->fd != -1)
+            return 0;
+        op = ALL_OUT_OP;
+    }
+
+    if (op == HERE_STRING_OP) {
+        redirect->action = REDIRECT_STRING;
+        return 1;
+    }
+
+    redirect->action = REDIRECT_OPEN;
+    if (op == REDIRECT_IN_OP)
+        redirect->flags = O_RDONLY;
+    else if (op == READ_WRITE_OP)
+        redirect->flags = O_RDWR|O_CREAT;
+    else if (op == APPEND_OP || op == ALL_APPEND_OP)
+        redirect->flags = O_WRONLY|O_CREAT|O_APPEND;
+    else
+        redirect->flags = O_WRONLY|O_CREAT|O_TRUNC;
+
+    if (op != ALL_OUT_OP && op != ALL_APPEND_OP)
+        return 1;
+
+    // Stderr is pointed at the same open file as stdout
+    redirects[1] = (Redirect) {REDIRECT_DUP, 2, 0, 1, NULL};
+    return 2;
+}
+
+/* Parses the tokens from up to but not including to of lex into a Pipeline
+ * held in a single allocation taken from arena. The tokens are those of a
+ * single pipeline, ended by a background operator if it has one, and source
+ * is the text that was lexed. A range without any commands gives a
+ * stageCount of 0.
+ * Returns NULL after printing a message if the pipeline is malformed. */
+Pipeline* parsePipeline(const Lexer* lex, const char* source, int from, int to, Arena* arena) {
+    // Counts the parts of the tree within the range to size it
+    int wordCount = 0;
+    int pipeCount = 0;
+    int redirectCount = 0;
+    int textStart = -1;
+    int textEnd = 0;
+    int expand = 0;
+    for (int i = from; i < to; i++) {
+        Token* token = &lex->tokens[i];
+        if (token->op == 0) {
+            wordCount++;
+            if (textStart == -1)
+                textStart = token->offset;
+            textEnd = token->offset + (int) strlen(lex->text + token->offset) + 1;
+            expand |= token->expand;
+        } else if (token->op == PIPE_OP) {
+            pipeCount++;
+        } else if (isRedirectOperator(token->op)) {
+            redirectCount += token->op == ALL_OUT_OP || token->op == ALL_APPEND_OP || token->op == DUP_OUT_OP ? 2 : 1;
+        }
+    }
+    int textLength = textStart == -1 ? 0 : textEnd - textStart;
+
+    // The pipeline as it was written, shown when it is listed as a job
+    int lineStart = from < to ? lex->tokens[from].start : 0;
+    int lineLength = from < to ? lex->tokens[to - 1].end - lineStart : 0;
+
+    // Lays the parts out one after another inside a single allocation
+    int stageCount = pipeCount + 1;
+    size_t size = sizeof(Pipeline)
+                  + sizeof(Stage) * stageCount
+                  + sizeof(char*) * (wordCount + stageCount)
+                  + sizeof(Redirect) * redirectCount
+                  + textLength + lineLength + 2;
+
+    Pipeline* pipeline = (Pipeline*) arenaAlloc(arena, size);
+    memset(pipeline, 0, size - textLength - lineLength - 2);
+    Stage* stages = (Stage*) (pipeline + 1);
+    char** args = (char**) (stages + stageCount);
+    Redirect* redirects = (Redirect*) (args + wordCount + stageCount);
+    char* text = (char*) (redirects + redirectCount);
+    char* line = text + textLength;
+
+    // The words of the range are stored one after another, so they are copied together
+    if (textLength > 0)
+        memcpy(text, lex->text + textStart, textLength);
+    memcpy(line, source + lineStart, lineLength);
+    line[lineLength] = '\n';
+    line[lineLength + 1] = '\0';
+
+    pipeline->stages = stages;
+    pipeline->line = line;
+    pipeline->expand = expand;
+    pipeline->size = size;
+
+    Stage* stage = &stages[0];
+    stage->args = args;
+    stage->redirects = redirects;
+    uint64_t stageStart = traceClock();
+
+    // A leading time keyword followed by a command times the pipeline instead of being run
+    int first = from;
+    if (to - from > 1 && lex->tokens[from].op == 0 && lex->tokens[from + 1].op == 0
+        && strcmp(tokenText(lex, &lex->tokens[from]), TIME_KEYWORD) == 0) {
+        pipeline->timed = 1;
+        first = from + 1;
+    }
+
+    for (int i = first; i < to; i++) {
+        Token* token = &lex->tokens[i];
+
+        // Words are the arguments of the current stage
+        if (token->op == 0) {
+            *args++ = text + token->offset - textStart;
+            stage->argCount++;
+
+        // A redirect takes the word that follows it and is resolved into the changes it makes
+        } else if (isRedirectOperator(token->op)) {
+            int resolved = 0;
+            if (i + 1 < to && lex->tokens[i + 1].op == 0)
+                resolved = resolveRedirect(token, text + lex->tokens[++i].offset - textStart, redirects);
+            if (resolved == 0) {
+                printf("Syntax error near %s\n", tokenText(lex, token));
+                return NULL;
+            }
+
+            redirects += resolved;
+            stage->redirectCount += resolved;
+
+        // A pipe ends the current stage and starts the next
+        } else if (token->op == PIPE_OP) {
+            if (stage->argCount == 0) {
+                printf("Syntax error near %s\n", tokenText(lex, token));
+                return NULL;
+            }
+
+            *args++ = NULL;
+            traceSpan("stage", stageStart, "index", pipeline->stageCount);
+            stageStart = traceClock();
+            pipeline->stageCount++;
+            stage++;
+            stage->args = args;
+            stage->redirects = redirects;
+
+        // A background operator can only end the pipeline
+        } else if (token->op == BG_OP && i + 1 == to) {
+            pipeline->background = 1;
+
+        // Newlines after a pipe continue the pipeline on the next line
+        } else if (token->op != NEWLINE_OP || i == first || lex->tokens[i - 1].op != PIPE_OP) {
+            printf("Syntax error near %s\n", tokenText(lex, token));
+            return NULL;
+        }
+    }
+
+    *args = NULL;
+
+    // The last stage only counts if it has a command, a line of just spaces has none
+    if (stage->argCount > 0) {
+        traceSpan("stage", stageStart, "index", pipeline->stageCount);
+        pipeline->stageCount++;
+    } else if (pipeline->stageCount > 0 || stage->redirectCount > 0 || pipeline->background) {
+        printf("Syntax error near end of line\n");
+        return NULL;
+    }
+
+    return pipeline;
+}
+
+/* Parses line, which holds a single pipeline, into a Pipeline held in a
+ * single allocation taken from arena. A line without any commands gives a
+ * stageCount of 0.
+ * Returns NULL after printing a message if the line is malformed. */
+Pipeline* parseLine(const char* line, Arena* arena) {
+    if (lexLine(&lexer, line) == -1) {
+        printf("Syntax error: unterminated quote\n");
+        return NULL;
+    }
+
+    // Trailing newlines end the line rather than being part of it
+    int count = lexer.tokenCount;
+    while (count > 0 && lexer.tokens[count - 1].op == NEWLINE_OP)
+        count--;
+
+    return parsePipeline(&lexer, line, 0, count, arena);
+}
+
+/* Returns where pointer points to once the block it is in moves by delta bytes. */
+void* moved(void* pointer, ptrdiff_t delta) {
+    return (char*) pointer + delta;
+}
+
+/* Copies the tree of pipeline into the pipeline->size bytes at to, pointing
+ * every part of the copy at the copy. Returns the copy. */
+Pipeline* copyPipeline(const Pipeline* pipeline, void* to) {
+    // Every pointer in the tree points inside its single allocation, so each moves by the same amount
+    Pipeline* copy = (Pipeline*) memcpy(to, pipeline, pipeline->size);
+    ptrdiff_t delta = (char*) copy - (char*) pipeline;
+
+    copy->stages = moved(copy->stages, delta);
+    for (int i = 0; i < copy->stageCount; i++) {
+        Stage* stage = &copy->stages[i];
+
+        stage->args = moved(stage->args, delta);
+        for (int j = 0; j < stage->argCount; j++)
+            stage->args[j] = moved(stage->args[j], delta);
+
+        stage->redirects = moved(stage->redirects, delta);
+        for (int j = 0; j < stage->redirectCount; j++) {
+            if (stage->redirects[j].file != NULL)
+                stage->redirects[j].file = moved(stage->redirects[j].file, delta);
+        }
+    }
+    copy->line = moved(copy->line, delta);
+
+    return copy;
+}
@@ -0,0 +1,90 @@
+/* Benjamin Schroeder
+ *
+ * parser.h
+ *
+ * The header file for the parser used to turn a pipeline into a parse
+ * tree. The tokens produced by the lexer are read once and arranged into a
+ * pipeline made up of stages, each holding its arguments and the changes
+ * its redirects make to its descriptors. The whole tree, including the
+ * text of every word, is held in a single allocation so it can be copied
+ * and moved as one block.
+ */
+
+#ifndef CS352P1_PARSER_H
+#define CS352P1_PARSER_H
+
+#include "arena.h"
+#include "lexer.h"
+
+/* What a redirect does to its descriptor. */
+#define REDIRECT_OPEN 0
+#define REDIRECT_DUP 1
+#define REDIRECT_CLOSE 2
+#define REDIRECT_STRING 3
+
+/* A single change made to a descriptor of a command. Every redirect
+ * operator is resolved into one or two of these when it is parsed, so
+ * starting the command only has to carry them out in order. */
+typedef struct Redirect {
+    /* One of the REDIRECT_ actions. */
+    char action;
+    /* The descriptor of the command that is changed. */
+    int fd;
+    /* The flags the file is opened with by REDIRECT_OPEN. */
+    int flags;
+    /* The descriptor copied onto fd by REDIRECT_DUP. */
+    int source;
+    /* The name of the file opened, or the text of a here-string given to
+     * REDIRECT_STRING, which is followed by a newline. NULL for the others. */
+    char *file;
+} Redirect;
+
+/* A single command of a pipeline. */
+typedef struct Stage {
+    /* The NULL terminated arguments of the command. */
+    char **args;
+    int argCount;
+    /* The redirects of the command in the order they were given. */
+    Redirect *redirects;
+    int redirectCount;
+} Stage;
+
+/* A parsed command line. */
+typedef struct Pipeline {
+    /* The commands connected by pipes, left to right. */
+    Stage *stages;
+    int stageCount;
+    /* Set if the line ended with a background operator. */
+    int background;
+    /* Set if the line started with the time keyword. */
+    int timed;
+    /* Set if a word holds variables that are expanded before it runs. */
+    int expand;
+    /* The pipeline as it was written followed by a newline. */
+    char *line;
+    /* The bytes taken by the whole tree, starting with the Pipeline itself. */
+    size_t size;
+} Pipeline;
+
+/* Parses the tokens from up to but not including to of lex into a Pipeline
+ * held in a single allocation taken from arena. The tokens are those of a
+ * single pipeline, ended by a background operator if it has one, and source
+ * is the text that was lexed. A range without any commands gives a
+ * stageCount of 0.
+ * Returns NULL after printing a message if the pipeline is malformed. */
+Pipeline* parsePipeline(const Lexer* lex, const char* source, int from, int to, Arena* arena);
+
+/* Parses line, which holds a single pipeline, into a Pipeline held in a
+ * single allocation taken from arena. A line without any commands gives a
+ * stageCount of 0.
+ * Returns NULL after printing a message if the line is malformed. */
+Pipeline* parseLine(const char* line, Arena* arena);
+
+/* Copies the tree of pipeline into the pipeline->size bytes at to, pointing
+ * every part of the copy at the copy. Returns the copy. */
+Pipeline* copyPipeline(const Pipeline* pipeline, void* to);
+
+/* Returns 1 if op is one of the redirect operators. */
+int isRedirectOperator(char op);
+
+#endif //CS352P1_PARSER_H
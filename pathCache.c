@@ -0,0 +1,188 @@
+/* Benjamin Schroeder
+ *
+ * pathCache.c
+ *
+ * An implementation of a hash table used to remember where commands were
+ * found on the PATH. Looking a command up the first time searches every
+ * directory in PATH and stores the absolute path that was found, every
+ * lookup after that is answered from the table. The table is cleared
+ * whenever PATH changes. Also keeps hit and miss counters which are
+ * reported by the hash builtin.
+ */
+
+#include "pathCache.h"
+#include "shellVariables.h"
+#include "vars.h"
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+/* A single command stored in the table. */
+typedef struct pathEntry {
+    // The name the command was looked up by
+    char* name;
+    // The absolute path the command was found at
+    char* path;
+    // How many times the entry has been used
+    int hits;
+    // The next entry in the same bucket
+    struct pathEntry* next;
+} pathEntry;
+
+// The buckets of the table, each holding a chain of entries
+pathEntry* buckets[PATH_CACHE_SIZE];
+
+// The value of PATH the entries in the table were found with
+char* cachedPath = NULL;
+
+// Counts lookups answered from the table and lookups that searched PATH
+int pathCacheHits = 0;
+int pathCacheMisses = 0;
+
+/* Hashes a command name into a bucket index using FNV-1a. */
+unsigned int hashName(const char* name) {
+    unsigned int hash = 2166136261u;
+
+    while (*name != '\0') {
+        hash ^= (unsigned char) *name++;
+        hash *= 16777619u;
+    }
+
+    return hash % PATH_CACHE_SIZE;
+}
+
+/* Searches every directory in path for an executable file called name.
+ * Returns a newly allocated absolute path or NULL if none was found. */
+char* searchPath(const char* path, const char* name) {
+    size_t nameLen = strlen(name);
+    const char* dir = path;
+
+    while (dir != NULL) {
+        // Finds the end of the current directory
+        const char* end = strchr(dir, ':');
+        size_t dirLen = end != NULL ? (size_t) (end - dir) : strlen(dir);
+
+        // Builds dir/name, an empty directory means the current directory
+        char* full = malloc(dirLen + nameLen + 3);
+        if (dirLen == 0) {
+            strcpy(full, ".");
+            dirLen = 1;
+        } else {
+            memcpy(full, dir, dirLen);
+        }
+        full[dirLen] = '/';
+        memcpy(full + dirLen + 1, name, nameLen + 1);
+
+        // Directories are skipped as execve would refuse them
+        struct stat info;
+        if (stat(full, &info) == 0 && S_ISREG(info.st_mode) && access(full, X_OK) == 0) {
+            return full;
+        }
+        free(full);
+
+        dir = end != NULL ? end + 1 : NULL;
+    }
+
+    return NULL;
+}
+
+/* Returns the absolute path of the command name, searching PATH and storing
+ * the result on a miss. Names containing a '/' are returned unchanged.
+ * Returns NULL if the command could not be found. */
+const char* pathCacheLookup(const char* name) {
+    // Paths are used as given, the same as execvp
+    if (strchr(name, '/') != NULL)
+        return name;
+
+    // Entries found with a different PATH may no longer be correct
+    const char* path = getVariable("PATH");
+    if (path == NULL)
+        path = "/bin:/usr/bin";
+
+    if (cachedPath == NULL || strcmp(cachedPath, path) != 0) {
+        pathCacheClear();
+        cachedPath = strdup(path);
+    }
+
+    // Checks the bucket the name hashes to
+    unsigned int index = hashName(name);
+    for (pathEntry* entry = buckets[index]; entry != NULL; entry = entry->next) {
+        if (strcmp(entry->name, name) == 0) {
+            entry->hits++;
+            pathCacheHits++;
+            return entry->path;
+        }
+    }
+
+    // Otherwise PATH is searched and the result remembered
+    pathCacheMisses++;
+    char* found = searchPath(path, name);
+    if (found == NULL)
+        return NULL;
+
+    pathEntry* entry = (pathEntry*) calloc(1, sizeof(pathEntry));
+    entry->name = strdup(name);
+    entry->path = found;
+    entry->hits = 1;
+    entry->next = buckets[index];
+    buckets[index] = entry;
+
+    return entry->path;
+}
+
+/* Removes the entry of the command name, used when the program it points
+ * at is no longer there so the next lookup searches PATH again. */
+void pathCacheForget(const char* name) {
+    for (pathEntry** link = &buckets[hashName(name)]; *link != NULL; link = &(*link)->next) {
+        pathEntry* entry = *link;
+        if (strcmp(entry->name, name) == 0) {
+            *link = entry->next;
+            free(entry->name);
+            free(entry->path);
+            free(entry);
+            return;
+        }
+    }
+}
+
+/* Removes every entry from the table. */
+void pathCacheClear() {
+    for (int i = 0; i < PATH_CACHE_SIZE; i++) {
+        pathEntry* entry = buckets[i];
+
+        while (entry != NULL) {
+            pathEntry* next = entry->next;
+            free(entry->name);
+            free(entry->path);
+            free(entry);
+            entry = next;
+        }
+        buckets[i] = NULL;
+    }
+
+    free(cachedPath);
+    cachedPath = NULL;
+}
+
+/* Prints every entry with the number of times it was used followed by
+ * the hit and miss counters. Used in the implementation of hash. */
+void pathCachePrint() {
+    int empty = 1;
+
+    for (int i = 0; i < PATH_CACHE_SIZE; i++) {
+        for (pathEntry* entry = buckets[i]; entry != NULL; entry = entry->next) {
+            if (empty) {
+                printf("hits\tcommand\n");
+                empty = 0;
+            }
+            printf("%4d\t%s\n", entry->hits, entry->path);
+        }
+    }
+
+    if (empty)
+        printf("hash: hash table empty\n");
+
+    printf("%d hits, %d misses\n", pathCacheHits, pathCacheMisses);
+}
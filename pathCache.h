@@ -0,0 +1,32 @@
+/* Benjamin Schroeder
+ *
+ * pathCache.h
+ *
+ * The header file for a hash table used to remember where commands were
+ * found on the PATH. Looking a command up the first time searches every
+ * directory in PATH and stores the absolute path that was found, every
+ * lookup after that is answered from the table. The table is cleared
+ * whenever PATH changes. Also keeps hit and miss counters which are
+ * reported by the hash builtin.
+ */
+
+#ifndef CS352P1_PATHCACHE_H
+#define CS352P1_PATHCACHE_H
+
+/* Returns the absolute path of the command name, searching PATH and storing
+ * the result on a miss. Names containing a '/' are returned unchanged.
+ * Returns NULL if the command could not be found. */
+const char* pathCacheLookup(const char* name);
+
+/* Removes the entry of the command name, used when the program it points
+ * at is no longer there so the next lookup searches PATH again. */
+void pathCacheForget(const char* name);
+
+/* Removes every entry from the table. */
+void pathCacheClear();
+
+/* Prints every entry with the number of times it was used followed by
+ * the hit and miss counters. Used in the implementation of hash. */
+void pathCachePrint();
+
+#endif //CS352P1_PATHCACHE_H
@@ -0,0 +1,395 @@
+/* Benjamin Schroeder
+ *
+ * pathGlob.c
+ *
+ * The implementation of matching words holding '*', '?' and '[...]' against
+ * the names of files. The lexer marks every one of those characters that is
+ * not quoted, and a word holding any is replaced by the sorted paths it
+ * matches, or kept as it is without the marks if it matches nothing. The
+ * entries of every directory read are kept in a small cache, read with
+ * getdents64 into a large buffer and sorted once, and used again for as long
+ * as the directory's modification time stays the same, so matching against
+ * a directory of many files does not read it again every time.
+ */
+
+#define _GNU_SOURCE
+
+#include "pathGlob.h"
+#include "stats.h"
+#include <dirent.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+
+/* An entry as written by getdents64. */
+typedef struct LinuxDirent64 {
+    ino64_t d_ino;
+    off64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[];
+} LinuxDirent64;
+
+// The cached directories, replaced least recently used first
+DirectoryIndex directories[GLOB_CACHE_SIZE];
+uint64_t directoryClock = 0;
+
+// The buffer getdents64 reads into, allocated on the first read
+char* readBuffer = NULL;
+
+// The path being built while matching, grown to fit the longest
+char* globPath = NULL;
+size_t globPathCapacity = 0;
+
+/* Returns the length of the bracket expression starting at the '[' at p,
+ * up to and including its ']', or 0 if it is not closed before end. A ']'
+ * right after the '[' or a leading '!' or '^' is part of the set. */
+size_t bracketLength(const char* p, const char* end) {
+    const char* c = p + 1;
+    if (c < end && (*c == '!' || *c == '^'))
+        c++;
+    if (c < end && *c == ']')
+        c++;
+
+    for (; c < end; c++) {
+        if (*c == ']')
+            return c - p + 1;
+    }
+    return 0;
+}
+
+/* Returns 1 if c is in the bracket expression of length bytes at set. */
+int matchBracket(const char* set, size_t length, char c) {
+    // Characters inside a set carry no meaning of their own, so their marks are dropped
+    char chars[length];
+    size_t count = 0;
+    for (size_t i = 1; i < length - 1; i++) {
+        if (set[i] != PATTERN_MARK)
+            chars[count++] = set[i];
+    }
+
+    size_t i = 0;
+    int negated = count > 0 && (chars[0] == '!' || chars[0] == '^');
+    if (negated)
+        i++;
+
+    int found = 0;
+    for (; i < count; i++) {
+        unsigned char low = chars[i];
+        unsigned char high = low;
+
+        // A '-' between two characters is a range, anywhere else it is itself
+        if (i + 2 < count && chars[i + 1] == '-') {
+            high = chars[i + 2];
+            i += 2;
+        }
+
+        if ((unsigned char) c >= low && (unsigned char) c <= high)
+            found = 1;
+    }
+
+    return found != negated;
+}
+
+/* Returns 1 if name matches the pattern from p up to end, with only the
+ * marked characters of the pattern having special meaning. */
+int matchComponent(const char* p, const char* end, const char* name) {
+    // Where to go back to when what follows the last '*' does not match
+    const char* starPattern = NULL;
+    const char* starName = NULL;
+
+    while (*name != '\0') {
+        if (p < end && *p == PATTERN_MARK && p[1] == '*') {
+            p += 2;
+            starPattern = p;
+            starName = name;
+            continue;
+        }
+
+        if (p < end && *p == PATTERN_MARK && p[1] == '?') {
+            p += 2;
+            name++;
+            continue;
+        }
+
+        if (p < end && *p == PATTERN_MARK && p[1] == '[') {
+            size_t length = bracketLength(p + 1, end);
+            if (length > 0 && matchBracket(p + 1, length, *name)) {
+                p += 1 + length;
+                name++;
+                continue;
+            }
+            // An open bracket without a closing one is an ordinary character
+            if (length == 0 && *name == '[') {
+                p += 2;
+                name++;
+                continue;
+            }
+        } else if (p < end && *p == *name) {
+            p++;
+            name++;
+            continue;
+        }
+
+        // The last '*' takes one more character and the rest is tried again
+        if (starPattern == NULL)
+            return 0;
+        p = starPattern;
+        name = ++starName;
+    }
+
+    while (p < end && *p == PATTERN_MARK && p[1] == '*')
+        p += 2;
+    return p == end;
+}
+
+/* Returns 1 if the pattern from p up to end holds a marked character that
+ * can match more than itself. */
+int hasGlobRange(const char* p, const char* end) {
+    for (; p < end; p++) {
+        if (*p != PATTERN_MARK)
+            continue;
+        if (p[1] == '*' || p[1] == '?' || (p[1] == '[' && bracketLength(p + 1, end) > 0))
+            return 1;
+    }
+    return 0;
+}
+
+/* Returns 1 if word holds a marked '*', '?' or '[' with a closing ']'. */
+int hasGlob(const char* word) {
+    return strchr(word, PATTERN_MARK) != NULL && hasGlobRange(word, word + strlen(word));
+}
+
+/* Returns a copy of word taken from arena without the marks the lexer put
+ * before '*', '?' and '['. */
+char* removeGlobMarks(const char* word, Arena* arena) {
+    char* copy = arenaCopy(arena, word, strlen(word));
+    char* to = copy;
+    for (const char* c = copy; *c != '\0'; c++) {
+        if (*c != PATTERN_MARK)
+            *to++ = *c;
+    }
+    *to = '\0';
+    return copy;
+}
+
+/* Returns the 64 bit FNV-1a hash of path. */
+uint64_t hashPath(const char* path) {
+    uint64_t hash = 14695981039346656037UL;
+    for (; *path != '\0'; path++) {
+        hash ^= (unsigned char) *path;
+        hash *= 1099511628211UL;
+    }
+    return hash;
+}
+
+// The names of the directory being sorted, as qsort gives the comparison no context
+const char* sortingNames;
+
+/* Orders two entries by name for qsort. */
+int compareEntries(const void* a, const void* b) {
+    return strcmp(sortingNames + ((const DirectoryEntry*) a)->offset,
+                  sortingNames + ((const DirectoryEntry*) b)->offset);
+}
+
+/* Reads every entry of the open directory into index and sorts them.
+ * Returns -1 if the directory could not be read. */
+int readDirectory(DirectoryIndex* index, int directory) {
+    if (readBuffer == NULL)
+        readBuffer = (char*) malloc(GLOB_READ_SIZE);
+
+    size_t namesUsed = 0;
+    index->count = 0;
+
+    long read;
+    while ((read = syscall(SYS_getdents64, directory, readBuffer, GLOB_READ_SIZE)) > 0) {
+        for (long position = 0; position < read;) {
+            LinuxDirent64* entry = (LinuxDirent64*) (readBuffer + position);
+            position += entry->d_reclen;
+
+            // The directory itself and its parent are never matched
+            if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0)
+                continue;
+
+            size_t length = strlen(entry->d_name) + 1;
+            if (namesUsed + length > index->namesSize) {
+                index->namesSize = (namesUsed + length) * 2;
+                index->names = (char*) realloc(index->names, index->namesSize);
+            }
+            if (index->count == index->entryCapacity) {
+                index->entryCapacity = index->entryCapacity == 0 ? 64 : index->entryCapacity * 2;
+                index->entries = (DirectoryEntry*) realloc(index->entries, sizeof(DirectoryEntry) * index->entryCapacity);
+            }
+
+            memcpy(index->names + namesUsed, entry->d_name, length);
+            index->entries[index->count++] = (DirectoryEntry) {(int) namesUsed, entry->d_type};
+            namesUsed += length;
+        }
+    }
+
+    // Matches come out sorted when the entries are walked in order
+    sortingNames = index->names;
+    qsort(index->entries, index->count, sizeof(DirectoryEntry), compareEntries);
+
+    return read == -1 ? -1 : 0;
+}
+
+/* Returns the index of the directory at path, read again if it changed
+ * since it was cached, or NULL if it cannot be read. */
+DirectoryIndex* loadDirectory(const char* path) {
+    struct stat info;
+    if (stat(path, &info) == -1 || !S_ISDIR(info.st_mode))
+        return NULL;
+
+    uint64_t hash = hashPath(path);
+    DirectoryIndex* index = NULL;
+    DirectoryIndex* oldest = NULL;
+    for (int i = 0; i < GLOB_CACHE_SIZE; i++) {
+        DirectoryIndex* slot = &directories[i];
+        if (slot->path != NULL && slot->hash == hash && strcmp(slot->path, path) == 0)
+            index = slot;
+        if (!slot->busy && (oldest == NULL || slot->path == NULL || (oldest->path != NULL && slot->used < oldest->used)))
+            oldest = slot;
+    }
+
+    // The same directory unchanged since it was read is used as it is
+    if (index != NULL && !index->racy && index->device == info.st_dev && index->inode == info.st_ino
+        && index->modified.tv_sec == info.st_mtim.tv_sec && index->modified.tv_nsec == info.st_mtim.tv_nsec) {
+        index->used = ++directoryClock;
+        stats.globHits++;
+        return index;
+    }
+
+    // Otherwise the directory is read into its old slot or the least recently used one
+    if (index == NULL || index->busy)
+        index = oldest;
+    if (index == NULL)
+        return NULL;
+
+    int directory = open(path, O_RDONLY|O_DIRECTORY|O_CLOEXEC);
+    if (directory == -1)
+        return NULL;
+
+    stats.globReads++;
+    free(index->path);
+    index->path = NULL;
+    int result = readDirectory(index, directory);
+    close(directory);
+    if (result == -1)
+        return NULL;
+
+    // A change made within a second of the read may not move the modification time, so it is not trusted yet
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    index->racy = info.st_mtim.tv_sec >= now.tv_sec - 1;
+
+    index->path = strdup(path);
+    index->hash = hash;
+    index->device = info.st_dev;
+    index->inode = info.st_ino;
+    index->modified = info.st_mtim;
+    index->used = ++directoryClock;
+    return index;
+}
+
+/* Makes room in the path being built for length more bytes past used. */
+void growGlobPath(size_t used, size_t length) {
+    if (used + length + 1 > globPathCapacity) {
+        globPathCapacity = (used + length + 1) * 2;
+        globPath = (char*) realloc(globPath, globPathCapacity);
+    }
+}
+
+/* Adds the path being built, of length bytes, to matches. */
+void addMatch(GlobMatches* matches, size_t length, Arena* arena) {
+    if (matches->count == matches->capacity) {
+        matches->capacity = matches->capacity == 0 ? 64 : matches->capacity * 2;
+        matches->paths = (char**) realloc(matches->paths, sizeof(char*) * matches->capacity);
+    }
+    matches->paths[matches->count++] = arenaCopy(arena, globPath, length);
+}
+
+/* Matches the rest of a pattern against the files under the first used
+ * bytes of the path being built, adding every full match to matches. */
+void globFrom(const char* rest, size_t used, GlobMatches* matches, Arena* arena) {
+    // Slashes are copied as they are
+    while (*rest == '/') {
+        growGlobPath(used, 1);
+        globPath[used++] = *rest++;
+    }
+
+    const char* end = strchr(rest, '/');
+    if (end == NULL)
+        end = rest + strlen(rest);
+
+    // A component without a pattern is part of the path, which must exist once it is complete
+    if (!hasGlobRange(rest, end)) {
+        growGlobPath(used, end - rest);
+        for (const char* c = rest; c < end; c++) {
+            if (*c != PATTERN_MARK)
+                globPath[used++] = *c;
+        }
+        globPath[used] = '\0';
+
+        struct stat info;
+        if (*end != '\0')
+            globFrom(end, used, matches, arena);
+        else if (lstat(globPath, &info) == 0)
+            addMatch(matches, used, arena);
+        return;
+    }
+
+    globPath[used] = '\0';
+    DirectoryIndex* index = loadDirectory(used == 0 ? "." : globPath);
+    if (index == NULL)
+        return;
+
+    // Names starting with a dot are hidden unless the pattern starts with one
+    int showHidden = rest[0] == '.';
+
+    index->busy++;
+    for (int i = 0; i < index->count; i++) {
+        const char* name = index->names + index->entries[i].offset;
+        if ((name[0] == '.' && !showHidden) || !matchComponent(rest, end, name))
+            continue;
+
+        size_t length = strlen(name);
+        growGlobPath(used, length);
+        memcpy(globPath + used, name, length + 1);
+
+        if (*end == '\0') {
+            addMatch(matches, used + length, arena);
+            continue;
+        }
+
+        // Only directories can hold the rest of the pattern, links and unknown types are checked
+        unsigned char type = index->entries[i].type;
+        struct stat info;
+        if (type == DT_DIR || ((type == DT_LNK || type == DT_UNKNOWN) && stat(globPath, &info) == 0 && S_ISDIR(info.st_mode)))
+            globFrom(end, used + length, matches, arena);
+    }
+    index->busy--;
+}
+
+/* Adds every path matching pattern to matches in sorted order, with the
+ * paths taken from arena. Names starting with '.' are only matched by a
+ * pattern starting with '.'. Returns the number of paths added. */
+int globPattern(const char* pattern, GlobMatches* matches, Arena* arena) {
+    int before = matches->count;
+    growGlobPath(0, strlen(pattern));
+    globFrom(pattern, 0, matches, arena);
+    return matches->count - before;
+}
+
+/* Forgets every cached directory. */
+void clearGlobCache() {
+    for (int i = 0; i < GLOB_CACHE_SIZE; i++) {
+        free(directories[i].path);
+        free(directories[i].names);
+        free(directories[i].entries);
+        directories[i] = (DirectoryIndex) {NULL};
+    }
+}
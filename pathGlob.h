@@ -0,0 +1,79 @@
+/* Benjamin Schroeder
+ *
+ * pathGlob.h
+ *
+ * The header file for matching words holding '*', '?' and '[...]' against
+ * the names of files. The lexer marks every one of those characters that is
+ * not quoted, and a word holding any is replaced by the sorted paths it
+ * matches, or kept as it is without the marks if it matches nothing. The
+ * entries of every directory read are kept in a small cache, read with
+ * getdents64 into a large buffer and sorted once, and used again for as long
+ * as the directory's modification time stays the same, so matching against
+ * a directory of many files does not read it again every time.
+ */
+
+#ifndef CS352P1_PATHGLOB_H
+#define CS352P1_PATHGLOB_H
+
+#include "shellVariables.h"
+#include "arena.h"
+#include <stdint.h>
+#include <sys/types.h>
+#include <time.h>
+
+/* A single name of a directory. */
+typedef struct DirectoryEntry {
+    /* Where the name starts in the names of its directory. */
+    int offset;
+    /* The d_type given by getdents64, DT_UNKNOWN if the file system does not say. */
+    unsigned char type;
+} DirectoryEntry;
+
+/* The entries of a directory as they were when it was last read. */
+typedef struct DirectoryIndex {
+    /* The directory as it was named in the pattern, or NULL if the slot is free. */
+    char *path;
+    uint64_t hash;
+    /* Which directory was read and when it last changed. */
+    dev_t device;
+    ino_t inode;
+    struct timespec modified;
+    /* Set if the directory changed too recently to tell whether it changed
+     * again within the same tick of its clock, so it is read every time. */
+    int racy;
+    /* Every name null terminated one after another, and the entries
+     * pointing at them sorted by name. */
+    char *names;
+    size_t namesSize;
+    DirectoryEntry *entries;
+    int count;
+    int entryCapacity;
+    /* Set while a match is walking the entries, so it is not replaced. */
+    int busy;
+    /* When the index was last used, to pick the one to replace. */
+    uint64_t used;
+} DirectoryIndex;
+
+/* The paths matched by a pattern. */
+typedef struct GlobMatches {
+    char **paths;
+    int count;
+    int capacity;
+} GlobMatches;
+
+/* Returns 1 if word holds a marked '*', '?' or '[' with a closing ']'. */
+int hasGlob(const char* word);
+
+/* Returns a copy of word taken from arena without the marks the lexer put
+ * before '*', '?' and '['. */
+char* removeGlobMarks(const char* word, Arena* arena);
+
+/* Adds every path matching pattern to matches in sorted order, with the
+ * paths taken from arena. Names starting with '.' are only matched by a
+ * pattern starting with '.'. Returns the number of paths added. */
+int globPattern(const char* pattern, GlobMatches* matches, Arena* arena);
+
+/* Forgets every cached directory. */
+void clearGlobCache();
+
+#endif //CS352P1_PATHGLOB_H
@@ -0,0 +1,571 @@
+/* Benjamin Schroeder
+ *
+ * plan.c
+ *
+ * The implementation of compiling command lines into plans. A line may hold
+ * many pipelines joined by ';', '&&', '||' and newlines, along with for,
+ * while, until and if commands that span many lines. The whole text is
+ * lexed once and compiled into a plan: a list of instructions that run a
+ * pipeline or jump based on the status of the last one, with every
+ * pipeline parsed ahead of time. A loop body is then run as many times as
+ * needed without being lexed or parsed again. Plans are cached by the text
+ * they were compiled from and shared by everyone running them.
+ */
+
+#include "plan.h"
+#include "parseCache.h"
+#include "trace.h"
+#include "vars.h"
+#include "expand.h"
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// The lexer is kept between plans so its buffers are reused
+Lexer planLexer;
+
+// The text and plan being compiled along with the token being read
+const char* planSource;
+Plan* compiling;
+int position;
+
+// The capacity of the instructions, pipelines and loops of the plan being compiled
+int codeCapacity;
+int pipelineCapacity;
+int loopCapacity;
+
+/* Returns the token being read, or NULL at the end of the text. */
+Token* currentToken() {
+    return position < planLexer.tokenCount ? &planLexer.tokens[position] : NULL;
+}
+
+/* Returns 1 if the token being read is the unquoted word keyword. */
+int atKeyword(const char* keyword) {
+    Token* token = currentToken();
+    return token != NULL && token->op == 0 && strcmp(planLexer.text + token->offset, keyword) == 0;
+}
+
+/* Returns 1 if the token being read is one of the count keywords. */
+int atAnyKeyword(const char* const* keywords, int count) {
+    for (int i = 0; i < count; i++) {
+        if (atKeyword(keywords[i]))
+            return 1;
+    }
+    return 0;
+}
+
+/* Prints a syntax error at the token being read. Returns PLAN_ERROR. */
+int syntaxError() {
+    Token* token = currentToken();
+    if (token == NULL)
+        printf("Syntax error near end of line\n");
+    else
+        printf("Syntax error near %s\n", tokenText(&planLexer, token));
+    return PLAN_ERROR;
+}
+
+/* Skips any newlines at the token being read. */
+void skipNewlines() {
+    while (currentToken() != NULL && currentToken()->op == NEWLINE_OP)
+        position++;
+}
+
+/* Adds an instruction to the plan. Returns its index so its target can be set later. */
+int emit(char op, int argument, int target) {
+    if (compiling->count == codeCapacity) {
+        codeCapacity = codeCapacity == 0 ? 16 : codeCapacity * 2;
+        compiling->code = (Instruction*) realloc(compiling->code, sizeof(Instruction) * codeCapacity);
+    }
+
+    compiling->code[compiling->count] = (Instruction) {op, argument, target};
+    return compiling->count++;
+}
+
+/* Reads the keyword that must come next, such as the 'do' of a loop.
+ * Returns PLAN_COMPLETE once it is read, PLAN_INCOMPLETE if the text ended
+ * before it or PLAN_ERROR if something else is there. */
+int expectKeyword(const char* keyword) {
+    skipNewlines();
+    if (currentToken() == NULL)
+        return PLAN_INCOMPLETE;
+    if (!atKeyword(keyword))
+        return syntaxError();
+
+    position++;
+    return PLAN_COMPLETE;
+}
+
+int compileList(const char* const* stops, int stopCount);
+
+/* Compiles a pipeline, which runs up to the next ';', newline, '&&' or '||',
+ * or up to and including a '&'. */
+int compilePipeline() {
+    int from = position;
+
+    while (currentToken() != NULL) {
+        char op = currentToken()->op;
+        if (op == SEQ_OP || op == NEWLINE_OP || op == AND_OP || op == OR_OP)
+            break;
+        position++;
+        if (op == BG_OP)
+            break;
+
+        // A pipe at the end of a line continues the pipeline on the next
+        if (op == PIPE_OP) {
+            while (currentToken() != NULL && currentToken()->op == NEWLINE_OP)
+                position++;
+            if (currentToken() == NULL)
+                return PLAN_INCOMPLETE;
+        }
+    }
+
+    Pipeline* pipeline = parsePipeline(&planLexer, planSource, from, position, &compiling->arena);
+    if (pipeline == NULL)
+        return PLAN_ERROR;
+
+    if (compiling->pipelineCount == pipelineCapacity) {
+        pipelineCapacity = pipelineCapacity == 0 ? 8 : pipelineCapacity * 2;
+        compiling->pipelines = (Pipeline**) realloc(compiling->pipelines, sizeof(Pipeline*) * pipelineCapacity);
+    }
+    compiling->pipelines[compiling->pipelineCount] = pipeline;
+    emit(PLAN_RUN, compiling->pipelineCount++, 0);
+
+    return PLAN_COMPLETE;
+}
+
+/* Compiles 'for name in words; do list; done'. */
+int compileFor() {
+    position++;
+
+    // The variable must be a name a variable can have
+    Token* name = currentToken();
+    if (name == NULL)
+        return PLAN_INCOMPLETE;
+    const char* text = planLexer.text + name->offset;
+    if (name->op != 0 || !(isalpha(text[0]) || text[0] == '_'))
+        return syntaxError();
+    for (int i = 1; text[i] != '\0'; i++) {
+        if (!(isalnum(text[i]) || text[i] == '_'))
+            return syntaxError();
+    }
+    position++;
+
+    int result = expectKeyword(IN_KEYWORD);
+    if (result != PLAN_COMPLETE)
+        return result;
+
+    // The words run up to the end of the line or a ';'
+    int first = position;
+    while (currentToken() != NULL && currentToken()->op == 0)
+        position++;
+    if (currentToken() == NULL)
+        return PLAN_INCOMPLETE;
+    if (currentToken()->op != SEQ_OP && currentToken()->op != NEWLINE_OP)
+        return syntaxError();
+
+    if (compiling->loopCount == loopCapacity) {
+        loopCapacity = loopCapacity == 0 ? 4 : loopCapacity * 2;
+        compiling->loops = (Loop*) realloc(compiling->loops, sizeof(Loop) * loopCapacity);
+    }
+    int index = compiling->loopCount++;
+    Loop* loop = &compiling->loops[index];
+    loop->expand = 0;
+    loop->name = arenaCopy(&compiling->arena, text, strlen(text));
+    loop->wordCount = position - first;
+    loop->words = (char**) arenaAlloc(&compiling->arena, sizeof(char*) * (loop->wordCount + 1));
+    for (int i = 0; i < loop->wordCount; i++) {
+        const char* word = planLexer.text + planLexer.tokens[first + i].offset;
+        loop->words[i] = arenaCopy(&compiling->arena, word, strlen(word));
+    }
+    loop->words[loop->wordCount] = NULL;
+    for (int i = 0; i < loop->wordCount; i++)
+        loop->expand |= planLexer.tokens[first + i].expand;
+    position++;
+
+    result = expectKeyword(DO_KEYWORD);
+    if (result != PLAN_COMPLETE)
+        return result;
+
+    // Each pass sets the variable to the next word, leaving the loop after the last
+    emit(PLAN_LOOP_START, index, 0);
+    int next = emit(PLAN_LOOP_NEXT, index, 0);
+
+    const char* stops[] = {DONE_KEYWORD};
+    result = compileList(stops, 1);
+    if (result == PLAN_COMPLETE)
+        result = expectKeyword(DONE_KEYWORD);
+    if (result != PLAN_COMPLETE)
+        return result;
+
+    emit(PLAN_JUMP, 0, next);
+    compiling->code[next].target = compiling->count;
+    return PLAN_COMPLETE;
+}
+
+/* Compiles 'while list; do list; done', or 'until' which loops while the
+ * condition fails. A loop that ends has the status of the last command of
+ * its body, or 0 if the body never ran. */
+int compileWhile(int until) {
+    position++;
+    int start = compiling->count;
+    int slot = compiling->savedCount++;
+
+    const char* conditionStops[] = {DO_KEYWORD};
+    int result = compileList(conditionStops, 1);
+    if (result == PLAN_COMPLETE)
+        result = expectKeyword(DO_KEYWORD);
+    if (result != PLAN_COMPLETE)
+        return result;
+
+    int leave = emit(until ? PLAN_JUMP_IF_SUCCEEDED : PLAN_JUMP_IF_FAILED, 0, 0);
+
+    const char* bodyStops[] = {DONE_KEYWORD};
+    result = compileList(bodyStops, 1);
+    if (result == PLAN_COMPLETE)
+        result = expectKeyword(DONE_KEYWORD);
+    if (result != PLAN_COMPLETE)
+        return result;
+
+    // The status of the body is kept so the condition failing does not replace it
+    emit(PLAN_SAVE_STATUS, slot, 0);
+    emit(PLAN_JUMP, 0, start);
+    compiling->code[leave].target = emit(PLAN_RESTORE_STATUS, slot, 0);
+    return PLAN_COMPLETE;
+}
+
+/* Compiles 'if list; then list; [elif list; then list;]... [else list;] fi'.
+ * When no condition succeeds and there is no else the status is 0. */
+int compileIf() {
+    // Every branch jumps past the others once it has run
+    int* ends = NULL;
+    int endCount = 0;
+    int result;
+
+    const char* conditionStops[] = {THEN_KEYWORD};
+    const char* branchStops[] = {ELIF_KEYWORD, ELSE_KEYWORD, FI_KEYWORD};
+
+    do {
+        position++;
+
+        result = compileList(conditionStops, 1);
+        if (result == PLAN_COMPLETE)
+            result = expectKeyword(THEN_KEYWORD);
+        if (result != PLAN_COMPLETE)
+            break;
+
+        int skip = emit(PLAN_JUMP_IF_FAILED, 0, 0);
+        result = compileList(branchStops, 3);
+        if (result != PLAN_COMPLETE)
+            break;
+        if (currentToken() == NULL) {
+            result = PLAN_INCOMPLETE;
+            break;
+        }
+
+        ends = (int*) realloc(ends, sizeof(int) * (endCount + 1));
+        ends[endCount++] = emit(PLAN_JUMP, 0, 0);
+        compiling->code[skip].target = compiling->count;
+    } while (atKeyword(ELIF_KEYWORD));
+
+    if (result == PLAN_COMPLETE) {
+        if (atKeyword(ELSE_KEYWORD)) {
+            position++;
+            const char* elseStops[] = {FI_KEYWORD};
+            result = compileList(elseStops, 1);
+        } else {
+            emit(PLAN_SET_STATUS, 0, 0);
+        }
+    }
+    if (result == PLAN_COMPLETE)
+        result = expectKeyword(FI_KEYWORD);
+
+    for (int i = 0; i < endCount; i++)
+        compiling->code[ends[i]].target = compiling->count;
+    free(ends);
+
+    return result;
+}
+
+/* Compiles a single command, either a pipeline or a compound command. */
+int compileCommand() {
+    Token* token = currentToken();
+    if (token == NULL)
+        return PLAN_INCOMPLETE;
+
+    // Keywords only have their meaning where a command would start
+    if (atKeyword(FOR_KEYWORD))
+        return compileFor();
+    if (atKeyword(WHILE_KEYWORD) || atKeyword(UNTIL_KEYWORD))
+        return compileWhile(atKeyword(UNTIL_KEYWORD));
+    if (atKeyword(IF_KEYWORD))
+        return compileIf();
+
+    const char* closers[] = {DO_KEYWORD, DONE_KEYWORD, THEN_KEYWORD, ELIF_KEYWORD, ELSE_KEYWORD, FI_KEYWORD};
+    if (atAnyKeyword(closers, 6))
+        return syntaxError();
+
+    // A command cannot start with an operator joining it to another
+    if (token->op == SEQ_OP || token->op == AND_OP || token->op == OR_OP || token->op == PIPE_OP || token->op == BG_OP)
+        return syntaxError();
+
+    return compilePipeline();
+}
+
+/* Compiles commands joined by '&&' and '||', which are run left to right
+ * with each one skipped based on the status of the one before it. */
+int compileAndOr() {
+    int result = compileCommand();
+
+    while (result == PLAN_COMPLETE && currentToken() != NULL
+           && (currentToken()->op == AND_OP || currentToken()->op == OR_OP)) {
+        // The jump lands just past the next command
+        int jump = emit(currentToken()->op == AND_OP ? PLAN_JUMP_IF_FAILED : PLAN_JUMP_IF_SUCCEEDED, 0, 0);
+        position++;
+        skipNewlines();
+
+        result = compileCommand();
+        compiling->code[jump].target = compiling->count;
+    }
+
+    return result;
+}
+
+/* Compiles commands separated by ';', '&' and newlines until the end of the
+ * text or one of the stopCount keywords where a command would start. */
+int compileList(const char* const* stops, int stopCount) {
+    while (1) {
+        while (currentToken() != NULL && (currentToken()->op == NEWLINE_OP || currentToken()->op == SEQ_OP))
+            position++;
+        if (currentToken() == NULL || atAnyKeyword(stops, stopCount))
+            return PLAN_COMPLETE;
+
+        int result = compileAndOr();
+        if (result != PLAN_COMPLETE)
+            return result;
+
+        // Commands are separated unless the last one ended with a '&'
+        Token* token = currentToken();
+        if (token != NULL && token->op != SEQ_OP && token->op != NEWLINE_OP
+            && planLexer.tokens[position - 1].op != BG_OP)
+            return syntaxError();
+    }
+}
+
+/* Lets go of a plan, freeing it once nothing holds it. */
+void releasePlan(Plan* plan) {
+    if (--plan->users > 0)
+        return;
+
+    arenaFree(&plan->arena);
+    free(plan->code);
+    free(plan->pipelines);
+    free(plan->loops);
+    free(plan);
+}
+
+/* Compiles the length bytes of text into a new plan stored in plan.
+ * Returns one of the PLAN_ results. */
+int compilePlan(const char* text, size_t length, Plan** plan) {
+    compiling = (Plan*) calloc(1, sizeof(Plan));
+    compiling->users = 1;
+    codeCapacity = 0;
+    pipelineCapacity = 0;
+    loopCapacity = 0;
+    position = 0;
+
+    // The text is copied as the lexer needs it null terminated
+    planSource = arenaCopy(&compiling->arena, text, length);
+
+    // A quote left open or a joined line is finished on the lines that follow
+    int result = lexLine(&planLexer, planSource) == -1 ? PLAN_INCOMPLETE : compileList(NULL, 0);
+
+    if (result != PLAN_COMPLETE) {
+        releasePlan(compiling);
+        compiling = NULL;
+        return result;
+    }
+
+    *plan = compiling;
+    compiling = NULL;
+    return PLAN_COMPLETE;
+}
+
+/* Compiles the length bytes of text into a plan stored in plan, taking it
+ * from the cache when the same text was compiled before. The plan is held
+ * until it is given to releasePlan.
+ * Returns PLAN_COMPLETE, PLAN_ERROR after printing a message if the text
+ * is malformed, or PLAN_INCOMPLETE if the text ends in the middle of a
+ * command and more lines are needed. */
+int loadPlan(const char* text, size_t length, Plan** plan) {
+    *plan = cachedPlan(text, length);
+    if (*plan != NULL)
+        return PLAN_COMPLETE;
+
+    uint64_t start = traceClock();
+    int result = compilePlan(text, length, plan);
+    traceSpan("compilePlan", start, "bytes", length);
+
+    if (result == PLAN_COMPLETE)
+        cachePlan(text, length, *plan);
+    return result;
+}
+
+/* Returns 1 if word is one of the count keywords. */
+int isKeyword(const char* word, const char* const* keywords, int count) {
+    for (int i = 0; i < count; i++) {
+        if (strcmp(word, keywords[i]) == 0)
+            return 1;
+    }
+    return 0;
+}
+
+/* Scans the lines of the length bytes of text that were not scanned before,
+ * with scan starting zeroed for the first line of a command.
+ * Returns 1 if the text may be a finished command worth compiling, or 0 if
+ * a block, quote or pipeline is still open and more lines are needed. */
+int scanPlan(PlanScan* scan, const char* text, size_t length) {
+    size_t count = length - scan->from;
+    if (scan->from == 0)
+        scan->commandStart = 1;
+
+    if (count + 1 > scan->linesCapacity) {
+        scan->linesCapacity = (count + 1) * 2;
+        scan->lines = (char*) realloc(scan->lines, scan->linesCapacity);
+    }
+    memcpy(scan->lines, text + scan->from, count);
+    scan->lines[count] = '\0';
+
+    // A quote or substitution left open is lexed again along with the lines that finish it
+    if (lexLine(&scan->lexer, scan->lines) == -1)
+        return 0;
+    scan->from = length;
+
+    const char* openers[] = {FOR_KEYWORD, WHILE_KEYWORD, UNTIL_KEYWORD, IF_KEYWORD};
+    const char* closers[] = {DONE_KEYWORD, FI_KEYWORD};
+    const char* leaders[] = {WHILE_KEYWORD, UNTIL_KEYWORD, IF_KEYWORD, DO_KEYWORD, THEN_KEYWORD, ELIF_KEYWORD, ELSE_KEYWORD};
+
+    for (int i = 0; i < scan->lexer.tokenCount; i++) {
+        const Token* token = &scan->lexer.tokens[i];
+
+        // Keywords only count where a command would start, and some are followed by another command
+        if (token->op == 0) {
+            const char* word = scan->lexer.text + token->offset;
+            if (scan->commandStart && isKeyword(word, openers, 4))
+                scan->depth++;
+            else if (scan->commandStart && isKeyword(word, closers, 2))
+                scan->depth--;
+            scan->commandStart = scan->commandStart && isKeyword(word, leaders, 7);
+            scan->lastOp = 0;
+
+        // A newline after a pipe continues the pipeline rather than starting a command
+        } else if (token->op == NEWLINE_OP) {
+            scan->commandStart = scan->commandStart || scan->lastOp != PIPE_OP;
+        } else {
+            scan->commandStart = token->op == SEQ_OP || token->op == AND_OP || token->op == OR_OP || token->op == BG_OP;
+            scan->lastOp = token->op;
+        }
+    }
+
+    return scan->depth <= 0 && scan->lastOp != PIPE_OP && scan->lastOp != AND_OP && scan->lastOp != OR_OP;
+}
+
+/* Forgets the lines scanned so the scan starts again with the next command. */
+void resetPlanScan(PlanScan* scan) {
+    scan->from = 0;
+    scan->depth = 0;
+    scan->lastOp = 0;
+}
+
+/* Frees the buffers of a scan. */
+void freePlanScan(PlanScan* scan) {
+    free(scan->lexer.tokens);
+    free(scan->lexer.text);
+    free(scan->lines);
+}
+
+/* Runs a plan, calling runPipeline with every pipeline it runs and the
+ * status of the plan so far, starting with the given status. Loop variables
+ * are set as shell variables.
+ * Returns the status of the last pipeline run, or PLAN_STOPPED if
+ * runPipeline returned PLAN_STOPPED. */
+int runPlan(const Plan* plan, int (*runPipeline)(const Pipeline*, int), int status) {
+    // How far each loop has got and the words it goes through, kept apart from the plan so it can be shared
+    int* passes = NULL;
+    char*** words = NULL;
+    int* wordCounts = NULL;
+    Arena* expanded = NULL;
+    if (plan->loopCount > 0) {
+        passes = (int*) calloc(plan->loopCount, sizeof(int));
+        words = (char***) calloc(plan->loopCount, sizeof(char**));
+        wordCounts = (int*) calloc(plan->loopCount, sizeof(int));
+        expanded = (Arena*) calloc(plan->loopCount, sizeof(Arena));
+    }
+    // The status of each while body, left at 0 whenever a loop is not running
+    int* saved = plan->savedCount > 0 ? (int*) calloc(plan->savedCount, sizeof(int)) : NULL;
+    int next = 0;
+
+    while (next < plan->count && status != PLAN_STOPPED) {
+        const Instruction* step = &plan->code[next++];
+
+        switch (step->op) {
+            case PLAN_RUN:
+                status = runPipeline(plan->pipelines[step->argument], status);
+                break;
+            case PLAN_JUMP:
+                next = step->target;
+                break;
+            case PLAN_JUMP_IF_FAILED:
+                if (status != 0)
+                    next = step->target;
+                break;
+            case PLAN_JUMP_IF_SUCCEEDED:
+                if (status == 0)
+                    next = step->target;
+                break;
+            case PLAN_LOOP_START: {
+                // Words with variables are expanded with the values they have as the loop starts
+                const Loop* loop = &plan->loops[step->argument];
+                words[step->argument] = loop->words;
+                wordCounts[step->argument] = loop->wordCount;
+                if (loop->expand) {
+                    arenaReset(&expanded[step->argument]);
+                    words[step->argument] = expandWords(loop->words, loop->wordCount, &wordCounts[step->argument],
+                                                        &expanded[step->argument]);
+                }
+
+                passes[step->argument] = 0;
+                status = 0;
+                break;
+            }
+            case PLAN_LOOP_NEXT: {
+                int pass = passes[step->argument]++;
+                if (pass == wordCounts[step->argument])
+                    next = step->target;
+                else
+                    setVariable(plan->loops[step->argument].name, words[step->argument][pass]);
+                break;
+            }
+            case PLAN_SET_STATUS:
+                status = step->argument;
+                break;
+            case PLAN_SAVE_STATUS:
+                saved[step->argument] = status;
+                break;
+            case PLAN_RESTORE_STATUS:
+                // Cleared so the loop starts from 0 again the next time it runs
+                status = saved[step->argument];
+                saved[step->argument] = 0;
+                break;
+        }
+    }
+
+    for (int i = 0; i < plan->loopCount; i++)
+        arenaFree(&expanded[i]);
+    free(expanded);
+    free(saved);
+    free(passes);
+    free(words);
+    free(wordCounts);
+    return status;
+}
@@ -0,0 +1,124 @@
+/* Benjamin Schroeder
+ *
+ * plan.h
+ *
+ * The header file for compiling command lines into plans. A line may hold
+ * many pipelines joined by ';', '&&', '||' and newlines, along with for,
+ * while, until and if commands that span many lines. The whole text is
+ * lexed once and compiled into a plan: a list of instructions that run a
+ * pipeline or jump based on the status of the last one, with every
+ * pipeline parsed ahead of time. A loop body is then run as many times as
+ * needed without being lexed or parsed again. Plans are cached by the text
+ * they were compiled from and shared by everyone running them.
+ */
+
+#ifndef CS352P1_PLAN_H
+#define CS352P1_PLAN_H
+
+#include "shellVariables.h"
+#include "parser.h"
+
+/* The operations of a plan. */
+#define PLAN_RUN 0
+#define PLAN_JUMP 1
+#define PLAN_JUMP_IF_FAILED 2
+#define PLAN_JUMP_IF_SUCCEEDED 3
+#define PLAN_LOOP_START 4
+#define PLAN_LOOP_NEXT 5
+#define PLAN_SET_STATUS 6
+#define PLAN_SAVE_STATUS 7
+#define PLAN_RESTORE_STATUS 8
+
+/* What compiling can end with. */
+#define PLAN_COMPLETE 0
+#define PLAN_ERROR -1
+#define PLAN_INCOMPLETE 1
+
+/* Returned by the function running a pipeline to end the plan early. */
+#define PLAN_STOPPED -1
+
+/* A single step of a plan. */
+typedef struct Instruction {
+    /* One of the PLAN_ operations. */
+    char op;
+    /* The pipeline run, the loop stepped, the status set or the slot it is saved in. */
+    int argument;
+    /* The instruction jumped to. */
+    int target;
+} Instruction;
+
+/* The variable and words of a for loop. */
+typedef struct Loop {
+    char *name;
+    char **words;
+    int wordCount;
+    /* Set if the words hold variables, expanded each time the loop starts. */
+    int expand;
+} Loop;
+
+/* A compiled command line. */
+typedef struct Plan {
+    Instruction *code;
+    int count;
+    /* Every pipeline run by the plan, each in a single allocation. */
+    Pipeline **pipelines;
+    int pipelineCount;
+    Loop *loops;
+    int loopCount;
+    /* Slots keeping the status of each while loop's body apart from its condition. */
+    int savedCount;
+    /* Holds the pipelines and the words of the loops. */
+    Arena arena;
+    /* How many are holding the plan, including the cache. */
+    int users;
+} Plan;
+
+/* Follows text given a line at a time, so a block spanning many lines is
+ * compiled once it is closed rather than again after every line. */
+typedef struct PlanScan {
+    /* Lexes the lines not yet scanned, kept apart from the lexer of plans. */
+    Lexer lexer;
+    /* A null terminated copy of the lines being lexed. */
+    char *lines;
+    size_t linesCapacity;
+    /* Where the lines not yet scanned start, held back while a quote is open. */
+    size_t from;
+    /* How many for, while, until and if commands are still open. */
+    int depth;
+    /* Set if the next word starts a command, where keywords have their meaning. */
+    int commandStart;
+    /* The last operator read other than a newline, or 0 after a word. */
+    char lastOp;
+} PlanScan;
+
+/* Scans the lines of the length bytes of text that were not scanned before,
+ * with scan starting zeroed for the first line of a command.
+ * Returns 1 if the text may be a finished command worth compiling, or 0 if
+ * a block, quote or pipeline is still open and more lines are needed. */
+int scanPlan(PlanScan* scan, const char* text, size_t length);
+
+/* Forgets the lines scanned so the scan starts again with the next command. */
+void resetPlanScan(PlanScan* scan);
+
+/* Frees the buffers of a scan. */
+void freePlanScan(PlanScan* scan);
+
+/* Compiles the length bytes of text into a plan stored in plan, taking it
+ * from the cache when the same text was compiled before. The plan is held
+ * until it is given to releasePlan.
+ * Returns PLAN_COMPLETE, PLAN_ERROR after printing a message if the text
+ * is malformed, or PLAN_INCOMPLETE if the text ends in the middle of a
+ * command and more lines are needed. */
+int loadPlan(const char* text, size_t length, Plan** plan);
+
+/* Lets go of a plan, freeing it once nothing holds it. */
+void releasePlan(Plan* plan);
+
+/* Runs a plan, calling runPipeline with every pipeline it runs and the
+ * status of the plan so far, starting with the given status. Loop variables
+ * are set as shell variables.
+ * Returns the status of the last pipeline run, or PLAN_STOPPED if
+ * runPipeline returned PLAN_STOPPED. */
+int runPlan(const Plan* plan, int (*runPipeline)(const Pipeline*, int), int status);
+
+#endif //CS352P1_PLAN_H
@@ -1,293 +1,664 @@
-/* Benjamin Schroeder
- *
- * processList.c
- *
- * An implementation of a doubly linked list used to track commands and processes not running
- * in the foreground of the shell. Provides functions inorder to create, add, and remove processes
- * from the list created. Also implements tracking features inorder to close out of existing
- * processes in an appropriate way, including stopped processes. Also provides the ability to
- * print the status of all the commands on the list.
- */
-
-#include "processList.h"
-#include <string.h>
-#include <stdio.h>
-#include <stdlib.h>
-#include <unistd.h>
-#include <fcntl.h>
-#include <wait.h>
-
-// Internally used to track assign process numbers to each processList node.
-int processNumber = 1;
-
-// The used to store the head (the furthest left node)
-processList* head = NULL;
-
-/* Creates a newProcess allocating memory and setting the default fields
- * then returns a reference to the created node. */
-processList* newProcess(Cmd* cmd, int output, int status)
-{
-    processList* list = (processList*) calloc(1, sizeof(processList));
-
-    list->next = NULL;
-    list->last = NULL;
-    list->cmd = cmd;
-    list->file = output;
-    list->status = status;
-    list->pid = processNumber;
-    processNumber++;
-
-    return list;
-}
-
-/* When given a process it is added to the double linked list at the
- * furthest right position. If the list is empty then it is set as the head
- * of the list. */
-void addProcess(processList* toAdd) {
-    if (head == NULL) {
-        // Sets it to the head if there is none
-        head = toAdd;
-    }
-    else {
-        // Creates a node to search
-        processList* node = head;
-
-        // Increments node to the last filled position
-        while (node->next != NULL)
-        {
-            node = node->next;
-        }
-
-        // Insets node into the list
-        node->next = toAdd;
-        toAdd->last = node;
-    }
-}
-
-/* Removes a given node from the list. When the head is removed
- * the next node takes its place. */
-void removeProcess(processList* toRemove) {
-    // Checks to see if there is even a list to remove from
-    if (head != NULL) {
-        if (head == toRemove) {
-            // If the head is the node that is to be removed
-            // Disconnects the head
-            processList *newlist = head->next;
-            head->next = NULL;
-
-            // Releases memory of the command and the node
-            free(toRemove->cmd);
-            free(toRemove);
-
-            if (newlist != NULL)
-                // If there is a next node then reference to head is removed
-                newlist->last = NULL;
-
-            // the next node is set to the head
-            head = newlist;
-        } else {
-            // Creates a node to search
-            processList* node = head;
-
-            // Node iterates through the list until it reaches the end or it finds
-            // the node to remove
-            while (node != NULL && node != toRemove) {
-                node = node->next;
-            }
-
-            // Checks if the node was found otherwise does nothing
-            if (node == toRemove) {
-                // Disconnects reference in the next node if there is one
-                if (node->next != NULL)
-                    node->next->last = node->last;
-
-                // Disconnects the rest of the node
-                // A last node can be assumed to exist since it was not the head
-                node->last->next = node->next;
-                node->last = NULL;
-                node->next = NULL;
-
-                // Frees the memory of the node
-                free(toRemove->cmd);
-                free(toRemove);
-            }
-        }
-    }
-}
-
-/* Prints the output of the command inside the node stored in  the
- * temporary file. Will not do this in the case that a foreground
- * node is stopped and restored as it was never assigned a tmpfile. */
-void printOutput(processList* node) {
-    // checks if there is an outfile
-    if (node->file != STDOUT_FILENO) {
-        // Creates a buffer
-        char *buff = malloc(sizeof(char) * 10);
-
-        // Goes to the start of the file
-        // May be unessicary as im not sure how file pointers act in children
-        lseek(node->file, SEEK_SET, 0);
-
-        // reads amount into buffer
-        size_t buffLen = read(node->file, buff, sizeof(buff));
-
-        // while the buffer isn't empty
-        while (buffLen > 0) {
-            // write the buffer to std out
-            write(STDOUT_FILENO, buff, buffLen);
-            // fill the buffer with the next section of the file
-            buffLen = read(node->file, buff, sizeof(buff));
-        }
-
-        // frees the memory of the buffer
-        free(buff);
-        // closes the tmpfile deleting it form memory
-        close(node->file);
-    }
-}
-
-/* Checks the status of all the processes in the list.
- * Is called at the end of each cycle through the main loop. */
-void checkProcessStatus() {
-    // Checks to see if there are any processes
-    if (head != NULL) {
-        //Creates a search node
-        processList* node = head;
-
-        //Iterates through every node
-        while (node != NULL) {
-            /* Only Running nodes that are activly running (those with
-             * a status of 0) have the possibility of needing to be updated
-             * so the rest can be ignored. */
-            if (node->status == 0) {
-                // creates a status variable to store status indicators from wait pid
-                int status;
-
-                // uses wait pid in conjunction with no WNOHANG to "check on the status"
-                node->status = waitpid(node->cmd->pid, &status, WNOHANG);
-
-                // If the node is no longer running processes need to be updates
-                if (node->status > 0) {
-                    /* If the node was signaled to stop then it prints the node was terminated
-                     * followed by identifying information. */
-                    if (WIFSIGNALED(status)) {
-                        /* Note: I am not specifically printing args as with the recursive program
-                         * it is possible for there to be multiple symbols in a line. The code below
-                         * acts functionally the same but also can display a more complex command if
-                         * symbols are in use in conjunction with a background operator. */
-                        printf("[%d] Terminated %s\n", node->pid, strtok(node->cmd->line, "&\n"));
-                        // Sets the node status to 2 that being the one used by terminated nodes
-                        node->status=-2;
-                    }
-
-                    /* If the node exited and the node status does not equal the pid then the node
-                     * exited with an error. In this case an error message is displayed with the status
-                     * code. */
-                    if (WIFEXITED(status) && WEXITSTATUS(status) != 0) {
-                        /* Note: I am not specifically printing args as with the recursive program
-                         * it is possible for there to be multiple symbols in a line. The code below
-                         * acts functionally the same but also can display a more complex command if
-                         * symbols are in use in conjunction with a background operator. Note in the
-                         * case of an error the message is dumped to console not quite sure on how to
-                         * delay the output as to make it less messy. */
-                        printf("[%d] Exit %d %s\n", node->pid, WEXITSTATUS(status), strtok(node->cmd->line, "&\n"));
-                        // Sets the status of the node to 1 so its marked for deletion
-                        node->status = 1;
-                    }
-
-                    /* If the node status equals the pid then the node exited successfully. A completion
-                     * message is printed along with the output of the node. */
-                    if (node->status == node->cmd->pid) {
-                        /* Note: I am not specifically printing args as with the recursive program
-                         * it is possible for there to be multiple symbols in a line. The code below
-                         * acts functionally the same but also can display a more complex command if
-                         * symbols are in use in conjunction with a background operator. */
-                        printf("[%d] Done %s: \n", node->pid, strtok(node->cmd->line, "&\n"));
-                        // Prints the output of the command
-                        printOutput(node);
-                    }
-                }
-            }
-            //Iterates node
-            node = node->next;
-        }
-
-        // Sets the iterator back to the beginning
-        node = head;
-
-        // Checks each node to see if they need to be removed
-        while (node != NULL) {
-            // Used inorder to not skip a node in code of the head being removed
-            int skip = 0;
-
-            // If a nodes status is greater than 0, then it is removed from the list
-            if (node->status > 0) {
-                // tmp holds the address of the head to check if it was removed
-                processList* tmp = head;
-
-                removeProcess(node);
-
-                // If the head address no longer matches tmp
-                if (head != tmp) {
-                    // Node is set to the new head
-                    node = head;
-                    // Skip is set to 1
-                    skip = 1;
-                }
-            }
-            // If skip was not changed
-            if (skip == 0)
-                // Iterate node
-                node = node->next;
-        }
-    }
-}
-
-/* Prints the status of every node.
- * Used in the implementation of jobs. */
-void printProcess() {
-    if (head == NULL)
-        // If there are no processes print an empty message.
-        printf("No processes to list.\n");
-    else {
-        // Otherwise create an iterator
-        processList* node = head;
-
-        // Go through every node
-        while (node != NULL) {
-            if (node->status == -2) {
-                // If the status is -2 then the node  is stopped
-                printf("[%d] Stopped\t%s", node->pid, node->cmd->line);
-            } else {
-                // Otherwise it is running
-                printf("[%d] Running\t%s", node->pid, node->cmd->line);
-            }
-            node = node->next;
-        }
-    }
-}
-
-/* Resumed a stopped process given a process id. */
-int resumeProcess(int processID) {
-    // checks if list is empty
-    if (head != NULL) {
-        processList* node = head;
-
-        // Checks every node if the pid matched if it does then the process is sent SIGCONT
-        while (node != NULL) {
-            if (node->pid == processID) {
-                kill(node->cmd->pid, SIGCONT);
-                node->status = 0;
-                return 0;
-            }
-            node = node->next;
-        }
-    }
-    return 1;
-}
-
-/* Deletes the entire list freeing any reserved memory. */
-void removeAllProcesses() {
-    while (head != NULL)
-        removeProcess(head);
-}
\ No newline at end of file
+/* Benjamin Schroeder
+ *
+ * processList.c
+ *
+ * An implementation of a job table used to track commands and processes not running
+ * in the foreground of the shell. Jobs are stored in a slot array indexed by their job
+ * number, along with a hash map from the OS process id of every stage to its job, so
+ * adding, removing and finding a job by either number takes constant time. Also
+ * implements tracking features inorder to close out of existing processes in an
+ * appropriate way, including stopped processes. Also provides the ability to print
+ * the status of all the commands in the table in job order.
+ */
+
+#include "processList.h"
+#include "reaper.h"
+#include "scheduler.h"
+#include "trace.h"
+#include "stats.h"
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <wait.h>
+#include <sys/sendfile.h>
+#include <sys/stat.h>
+
+/* An entry of the map from OS process ids to jobs. */
+typedef struct pidEntry {
+    // The process id, 0 for an empty entry and -1 for a removed one
+    pid_t pid;
+    Job* job;
+} pidEntry;
+
+// The slot array, jobs[n] holds job number n or NULL
+Job** jobs = NULL;
+int jobCapacity = 0;
+
+// The highest job number in use, the next job is given the number after it
+int highestJob = 0;
+
+// The number of background jobs that are running
+int activeJobs = 0;
+
+// The command running in the foreground or NULL
+Cmd* foregroundCmd = NULL;
+
+// The map from OS process ids to jobs using open addressing
+pidEntry* pidMap = NULL;
+int pidCapacity = 0;
+// Entries in use, including removed entries as they still lengthen searches
+int pidUsed = 0;
+// Entries holding a process id that is still mapped
+int pidLive = 0;
+
+/* Returns the first slot to check for a process id in the map. */
+int pidSlot(pid_t pid) {
+    return (int) (((unsigned int) pid * 2654435761u) & (unsigned int) (pidCapacity - 1));
+}
+
+/* Adds a process id to the map, rebuilding it when half full. The map
+ * only grows when more than a quarter of it is live, otherwise it is
+ * rebuilt at the same size to clear out the removed entries. */
+void mapPid(pid_t pid, Job* job) {
+    if ((pidUsed + 1) * 2 > pidCapacity) {
+        pidEntry* old = pidMap;
+        int oldCapacity = pidCapacity;
+
+        if (pidCapacity == 0)
+            pidCapacity = 64;
+        else if ((pidLive + 1) * 4 > pidCapacity)
+            pidCapacity *= 2;
+        pidMap = (pidEntry*) calloc(pidCapacity, sizeof(pidEntry));
+        pidUsed = 0;
+        pidLive = 0;
+
+        for (int i = 0; i < oldCapacity; i++) {
+            if (old[i].pid > 0)
+                mapPid(old[i].pid, old[i].job);
+        }
+        free(old);
+    }
+
+    int slot = pidSlot(pid);
+    while (pidMap[slot].pid > 0)
+        slot = (slot + 1) & (pidCapacity - 1);
+
+    if (pidMap[slot].pid == 0)
+        pidUsed++;
+    pidLive++;
+
+    pidMap[slot].pid = pid;
+    pidMap[slot].job = job;
+}
+
+/* Returns the slot holding a process id or -1 if it is not in the map. */
+int findPid(pid_t pid) {
+    if (pidCapacity == 0)
+        return -1;
+
+    int slot = pidSlot(pid);
+    while (pidMap[slot].pid != 0) {
+        if (pidMap[slot].pid == pid)
+            return slot;
+        slot = (slot + 1) & (pidCapacity - 1);
+    }
+
+    return -1;
+}
+
+/* Removes a process id from the map if it is mapped to the given job.
+ * A process id can be reused by the OS once reaped, so the job is checked
+ * to avoid removing the entry of a newer job. */
+void unmapPid(pid_t pid, Job* job) {
+    int slot = findPid(pid);
+    if (slot != -1 && pidMap[slot].job == job) {
+        pidMap[slot].pid = -1;
+        pidLive--;
+    }
+}
+
+/* Creates a newProcess allocating memory and setting the default fields
+ * then returns a reference to the created job. */
+Job* newProcess(Cmd* cmd, int output, int status)
+{
+    Job* job = (Job*) calloc(1, sizeof(Job));
+
+    job->cmd = cmd;
+    job->file = output;
+    job->status = status;
+
+    return job;
+}
+
+/* Gives a job the number after the highest in use and adds it to the
+ * table, mapping the process id of every stage to it. */
+void addProcess(Job* toAdd) {
+    toAdd->number = highestJob + 1;
+
+    // Grows the slot array when the number does not fit
+    if (toAdd->number >= jobCapacity) {
+        int oldCapacity = jobCapacity;
+        jobCapacity = jobCapacity == 0 ? 16 : jobCapacity * 2;
+        jobs = (Job**) realloc(jobs, sizeof(Job*) * jobCapacity);
+        memset(jobs + oldCapacity, 0, sizeof(Job*) * (jobCapacity - oldCapacity));
+    }
+
+    jobs[toAdd->number] = toAdd;
+    highestJob = toAdd->number;
+
+    if (toAdd->status == 0 && !toAdd->held)
+        activeJobs++;
+
+    mapStages(toAdd);
+}
+
+/* Maps the process id of every stage of a job that was started after it
+ * was added to the table. */
+void mapStages(Job* job) {
+    for (int i = 0; i < job->cmd->stageCount; i++) {
+        if (job->cmd->pids[i] > 0)
+            mapPid(job->cmd->pids[i], job);
+    }
+}
+
+/* Changes the status of a job, 0 while running, -2 while stopped and -3
+ * while queued, keeping count of the background jobs that are running. */
+void setProcessStatus(Job* job, int status) {
+    if (!job->held && job->status == 0 && status != 0)
+        activeJobs--;
+    else if (!job->held && job->status != 0 && status == 0)
+        activeJobs++;
+
+    job->status = status;
+}
+
+/* Returns the number of background jobs running, not counting stopped and
+ * queued jobs or the tasks of builtins. */
+int runningJobs() {
+    return activeJobs;
+}
+
+/* Removes a given job from the table, freeing it along with its command.
+ * Job numbers above the highest remaining job become free again. */
+void removeProcess(Job* toRemove) {
+    if (toRemove->stream != NULL)
+        closeStream(toRemove->stream);
+
+    // A queued job leaves the queue, a running one frees its place for a queued job
+    if (toRemove->status == -3)
+        unqueueProcess(toRemove);
+    setProcessStatus(toRemove, -1);
+
+    for (int i = 0; i < toRemove->cmd->stageCount; i++)
+        unmapPid(toRemove->cmd->pids[i], toRemove);
+
+    jobs[toRemove->number] = NULL;
+    while (highestJob > 0 && jobs[highestJob] == NULL)
+        highestJob--;
+
+    freeCmd(toRemove->cmd);
+    free(toRemove->cpus);
+    free(toRemove);
+}
+
+/* Returns the job with the given job number or NULL if there is none. */
+Job* findJob(int number) {
+    if (number <= 0 || number > highestJob)
+        return NULL;
+    return jobs[number];
+}
+
+/* Returns the job with a stage running as the given OS process id or
+ * NULL if no job has the process. */
+Job* findProcess(pid_t pid) {
+    int slot = findPid(pid);
+    return slot == -1 ? NULL : pidMap[slot].job;
+}
+
+/* Copies everything in file to out starting from the beginning of file.
+ * The data is passed with sendfile so it never enters the shell, falling
+ * back to reading and writing large blocks when out does not support it.
+ * Returns the number of bytes copied. */
+off_t replayOutput(int file, int out) {
+    struct stat info;
+    if (fstat(file, &info) == -1)
+        return 0;
+
+    // The offset is passed in so the position the job left the file at does not matter
+    off_t offset = 0;
+    while (offset < info.st_size) {
+        ssize_t sent = sendfile(out, file, &offset, info.st_size - offset);
+        if (sent <= 0)
+            break;
+    }
+
+    // Falls back to a large buffer if sendfile stopped before the end
+    if (offset < info.st_size) {
+        static char* buff = NULL;
+        if (buff == NULL)
+            buff = (char*) malloc(REPLAY_BUFFER_SIZE);
+
+        ssize_t buffLen;
+        while ((buffLen = pread(file, buff, REPLAY_BUFFER_SIZE, offset)) > 0) {
+            // write may take less than the whole buffer when out is a pipe
+            for (ssize_t written = 0; written < buffLen; ) {
+                ssize_t result = write(out, buff + written, buffLen - written);
+                if (result <= 0) {
+                    stats.capturedBytes += offset + written;
+                    return offset + written;
+                }
+                written += result;
+            }
+            offset += buffLen;
+        }
+    }
+
+    stats.capturedBytes += offset;
+    return offset;
+}
+
+/* Prints the output of the command inside the job stored in  the
+ * temporary file. Will not do this in the case that a foreground
+ * job is stopped and restored as it was never assigned a tmpfile. */
+void printOutput(Job* job) {
+    // checks if there is an outfile
+    if (job->file != STDOUT_FILENO) {
+        // Messages already printed have to come before the output
+        fflush(stdout);
+
+        replayOutput(job->file, STDOUT_FILENO);
+
+        // closes the tmpfile deleting it form memory
+        close(job->file);
+    }
+}
+
+/* Prints how a finished job ended followed by its output if it
+ * completed successfully. */
+void reportProcess(Job* job) {
+    // The status of a pipeline is the status of its last stage
+    int status = job->cmd->statuses[job->cmd->stageCount - 1];
+
+    if (job->exitStatus != NULL)
+        *job->exitStatus = exitCode(status);
+    stats.jobsDone++;
+
+    // Streamed output is finished before the job is reported
+    if (job->stream != NULL) {
+        closeStream(job->stream);
+        job->stream = NULL;
+    }
+
+    /* If the job was signaled to stop then it prints the job was terminated
+     * followed by identifying information. */
+    if (WIFSIGNALED(status)) {
+        /* Note: I am not specifically printing args as with the recursive program
+         * it is possible for there to be multiple symbols in a line. The code below
+         * acts functionally the same but also can display a more complex command if
+         * symbols are in use in conjunction with a background operator. */
+        printf("[%d] Terminated %s\n", job->number, strtok(job->cmd->line, "&\n"));
+
+    /* If the job exited with a non zero status an error message is displayed with
+     * the status code. */
+    } else if (WEXITSTATUS(status) != 0) {
+        /* Note: in the case of an error the message is dumped to console not quite
+         * sure on how to delay the output as to make it less messy. */
+        printf("[%d] Exit %d %s\n", job->number, WEXITSTATUS(status), strtok(job->cmd->line, "&\n"));
+
+    /* Otherwise the job exited successfully. A completion message is printed
+     * along with the output of the job. */
+    } else {
+        printf("[%d] Done %s: \n", job->number, strtok(job->cmd->line, "&\n"));
+    }
+
+    // Pipelines also report the exit status of every stage
+    printPipeStatus(job->cmd);
+
+    // A timed job reports the time it took
+    if (job->cmd->pipeline->timed)
+        printTime(job->cmd);
+
+    // Prints the output of a command that completed successfully
+    if (WIFEXITED(status) && WEXITSTATUS(status) == 0)
+        printOutput(job);
+}
+
+/* Applies every status change queued by the reaper to the job it belongs
+ * to, found through the process id map so only jobs that changed are looked
+ * at. The foreground command is not in the table and is checked first when
+ * it is given. Finished jobs are reported and removed from the table, apart
+ * from held jobs which are left for their owner.
+ * Returns the number of jobs that were reported. */
+int checkProcessStatus(Cmd* foreground) {
+    int reported = 0;
+    ChildEvent event;
+
+    // Runs the handler for any SIGCHLD that arrived while it was blocked
+    deliverChildSignals();
+
+    while (nextChildEvent(&event)) {
+        pid_t pid = event.pid;
+        int status = event.status;
+
+        if (!WIFSTOPPED(status) && !WIFCONTINUED(status))
+            stats.reaped++;
+
+        if (foreground != NULL && recordStatus(foreground, &event))
+            continue;
+
+        Job* job = findProcess(pid);
+        if (job == NULL || !recordStatus(job->cmd, &event))
+            continue;
+
+        // A process that exited is unmapped right away as its id may be reused
+        if (!WIFSTOPPED(status) && !WIFCONTINUED(status))
+            unmapPid(pid, job);
+
+        if (runningStages(job->cmd) == 0 && job->held) {
+            // The owner of a held job finds it finished through its stages
+            continue;
+        } else if (runningStages(job->cmd) == 0) {
+            // Once every stage has finished the job is reported and removed
+            reportProcess(job);
+            removeProcess(job);
+            reported++;
+        } else if (WIFSTOPPED(status)) {
+            // Sets the job status to -2 that being the one used by stopped jobs
+            setProcessStatus(job, -2);
+        } else if (WIFCONTINUED(status)) {
+            setProcessStatus(job, 0);
+        }
+    }
+
+    // Jobs that finished or stopped make room for queued jobs
+    admitProcesses();
+
+    return reported;
+}
+
+/* Sleeps until a child changes state, printing any streamed output that
+ * arrives in the meantime. */
+void waitForChange() {
+    struct pollfd events = {streamPollFd(), POLLIN, 0};
+    waitForEvents(&events, 1);
+    drainStreams();
+}
+
+/* Waits for every stage of cmd, which is not in the table, to finish or
+ * for one to be stopped, printing streamed output while it waits. A stopped
+ * command is added to the table. Returns the wait status of the last stage
+ * or -2 if the command was stopped. */
+int waitForeground(Cmd* cmd) {
+    uint64_t start = traceClock();
+    foregroundCmd = cmd;
+
+    checkProcessStatus(cmd);
+    while (runningStages(cmd) > 0 && stoppedStages(cmd) == 0) {
+        waitForChange();
+        checkProcessStatus(cmd);
+    }
+
+    foregroundCmd = NULL;
+    traceSpan("waitForeground", start, "pid", cmd->pid);
+
+    // A stopped command is added to the table
+    if (runningStages(cmd) > 0) {
+        addProcess(newProcess(cmd, STDOUT_FILENO, -2));
+        return -2;
+    }
+
+    return cmd->statuses[cmd->stageCount - 1];
+}
+
+/* Continues the job with the given job number, or the highest one when the
+ * number is 0, and waits for it in the foreground until it is reported or
+ * stopped again. Returns the exit status of the job once it is reported,
+ * 128 plus SIGTSTP if it was stopped again or -1 if there is no such job. */
+int foregroundProcess(int number) {
+    if (number == 0)
+        number = highestJob;
+
+    Job* job = findJob(number);
+    if (job == NULL)
+        return -1;
+
+    printf("%s", job->cmd->line);
+    fflush(stdout);
+
+    // The exit status is stored here when the job is reported, even if that happens as it starts
+    int code = 0;
+    job->exitStatus = &code;
+
+    // A queued job that cannot be started has already been removed
+    if (resumeProcess(number) == 1)
+        return -1;
+    foregroundCmd = job->cmd;
+
+    // The job is removed from the table once it has been reported
+    while (findJob(number) == job && job->status != -2) {
+        waitForChange();
+        checkProcessStatus(NULL);
+    }
+
+    foregroundCmd = NULL;
+    if (findJob(number) == job) {
+        job->exitStatus = NULL;
+        return 128 + SIGTSTP;
+    }
+    return code;
+}
+
+/* Waits for the count jobs with the given job numbers, or every background
+ * job when count is 0, to finish. With any set it returns once the first
+ * of them finishes. While every job waited on has a pidfd the shell sleeps
+ * in poll on exactly those pidfds, otherwise it is woken by any child.
+ * Stopped jobs are not waited for. Returns the exit status of the last job
+ * given or of the first to finish with any, or 127 if a job does not exist. */
+int waitProcesses(int* numbers, int count, int any) {
+    // Jobs that already finished are reported before anything is waited on
+    uint64_t start = traceClock();
+    checkProcessStatus(NULL);
+
+    // Every background job is waited on when none are given
+    int all = count == 0;
+    if (all) {
+        numbers = (int*) malloc(sizeof(int) * (highestJob + 1));
+        for (int i = 1; i <= highestJob; i++) {
+            if (jobs[i] != NULL && !jobs[i]->held)
+                numbers[count++] = i;
+        }
+    }
+
+    int* codes = (int*) malloc(sizeof(int) * (count + 1));
+    Job** waited = (Job**) malloc(sizeof(Job*) * (count + 1));
+    int result = 0;
+
+    for (int i = 0; i < count; i++) {
+        codes[i] = -1;
+        waited[i] = findJob(numbers[i]);
+        if (waited[i] != NULL)
+            waited[i]->exitStatus = &codes[i];
+        else if (!all)
+            codes[i] = 127;
+    }
+
+    // The pidfds of every running stage followed by the streams
+    struct pollfd* events = NULL;
+    int eventCapacity = 0;
+
+    while (1) {
+        int remaining = 0;
+        int finished = -1;
+        int eventCount = 0;
+        int anyChild = 0;
+
+        for (int i = 0; i < count; i++) {
+            Job* job = waited[i];
+
+            // A job that was reported has left the table, no new jobs are added while waiting
+            if (job != NULL && findJob(numbers[i]) != job) {
+                waited[i] = NULL;
+                job = NULL;
+                if (finished == -1)
+                    finished = i;
+            }
+            if (job == NULL || job->status == -2)
+                continue;
+
+            // A started job with no running stages never wakes the poll, so it is finished here
+            if (job->status != -3 && runningStages(job->cmd) == 0) {
+                reportProcess(job);
+                removeProcess(job);
+                waited[i] = NULL;
+                if (finished == -1)
+                    finished = i;
+                continue;
+            }
+
+            remaining++;
+            if (job->status == -3)
+                anyChild = 1;
+
+            for (int j = 0; j < job->cmd->stageCount; j++) {
+                if (job->cmd->statuses[j] >= 0)
+                    continue;
+                if (job->cmd->pidfds[j] == -1)
+                    anyChild = 1;
+
+                if (eventCount + 1 >= eventCapacity) {
+                    eventCapacity = eventCapacity == 0 ? 16 : eventCapacity * 2;
+                    events = (struct pollfd*) realloc(events, sizeof(struct pollfd) * eventCapacity);
+                }
+                events[eventCount++] = (struct pollfd) {job->cmd->pidfds[j], POLLIN, 0};
+            }
+        }
+
+        if (remaining == 0 || (any && finished != -1)) {
+            if (any && finished != -1)
+                result = codes[finished];
+            break;
+        }
+
+        // Streamed output keeps being printed so no job is blocked writing it
+        if (eventCount + 1 >= eventCapacity) {
+            eventCapacity = eventCapacity == 0 ? 16 : eventCapacity * 2;
+            events = (struct pollfd*) realloc(events, sizeof(struct pollfd) * eventCapacity);
+        }
+        events[eventCount++] = (struct pollfd) {streamPollFd(), POLLIN, 0};
+
+        // Nothing left to poll could ever wake the shell, so waiting would never return
+        if (!anyChild && eventCount == 1 && events[0].fd == -1)
+            break;
+
+        // Jobs without a pidfd, or queued jobs waiting for others to finish, need any child to wake the shell
+        if (anyChild)
+            waitForEvents(events, eventCount);
+        else
+            poll(events, eventCount, -1);
+
+        drainStreams();
+        checkProcessStatus(NULL);
+    }
+
+    // The last job given decides the status
+    if (!any && count > 0)
+        result = codes[count - 1] == -1 ? 0 : codes[count - 1];
+
+    // Jobs still in the table no longer point at the codes
+    for (int i = 0; i < count; i++) {
+        if (waited[i] != NULL)
+            waited[i]->exitStatus = NULL;
+    }
+
+    traceSpan("wait", start, "jobs", count);
+
+    free(events);
+    free(waited);
+    free(codes);
+    if (all)
+        free(numbers);
+    return result;
+}
+
+/* Prints the status of every job in job order, followed by the state and
+ * resource usage of each stage when detailed is set.
+ * Used in the implementation of jobs. */
+void printProcess(int detailed) {
+    if (highestJob == 0) {
+        // If there are no processes print an empty message.
+        printf("No processes to list.\n");
+        return;
+    }
+
+    for (int i = 1; i <= highestJob; i++) {
+        Job* job = jobs[i];
+
+        if (job == NULL)
+            continue;
+
+        if (job->status == -2) {
+            // If the status is -2 then the job is stopped
+            printf("[%d] Stopped\t%s", job->number, job->cmd->line);
+        } else if (job->status == -3) {
+            // If the status is -3 then the job is waiting to be started
+            printf("[%d] Queued\t%s", job->number, job->cmd->line);
+        } else {
+            // Otherwise it is running
+            printf("[%d] Running\t%s", job->number, job->cmd->line);
+        }
+
+        if (detailed)
+            printStageUsage(job->cmd, stdout);
+    }
+}
+
+/* Resumed a stopped job given its job number, or starts a queued job. */
+int resumeProcess(int processID) {
+    Job* job = findJob(processID);
+
+    if (job == NULL)
+        return 1;
+
+    // A queued job is started right away, whatever the number of jobs running
+    if (job->status == -3) {
+        unqueueProcess(job);
+        return startProcess(job) == -1 ? 1 : 0;
+    }
+
+    // Every stage of the job is sent SIGCONT
+    signalPipeline(job->cmd, SIGCONT);
+    setProcessStatus(job, 0);
+    return 0;
+}
+
+/* Deletes the entire table freeing any reserved memory. */
+void removeAllProcesses() {
+    while (highestJob > 0)
+        removeProcess(jobs[highestJob]);
+
+    free(jobs);
+    free(pidMap);
+    jobs = NULL;
+    pidMap = NULL;
+    jobCapacity = 0;
+    pidCapacity = 0;
+    pidUsed = 0;
+    pidLive = 0;
+}
+
+/* Empties the table without touching any job, used by a copy of the shell
+ * as the jobs belong to the original. */
+void forgetProcesses() {
+    forgetQueue();
+    activeJobs = 0;
+    jobs = NULL;
+    pidMap = NULL;
+    jobCapacity = 0;
+    highestJob = 0;
+    pidCapacity = 0;
+    pidUsed = 0;
+    pidLive = 0;
+}
@@ -1,65 +1,146 @@
-/* Benjamin Schroeder
- *
- * processList.h
- *
- * The header file for a doubly linked list used to track commands and processes not running
- * in the foreground of the shell. Provides functions inorder to create, add, and remove processes
- * from the list created. Also implements tracking features inorder to close out of existing
- * processes in an appropriate way, including stopped processes. Also provides the ability to
- * print the status of all the commands on the list.
- */
-
-#ifndef CS352P1_PROCESSLIST_H
-#define CS352P1_PROCESSLIST_H
-
-#include "Cmd.h"
-
-/* Implements a doubly linked list used to store and manage background processes. */
-typedef struct processList
-{
-    // Stores the associated command
-    Cmd* cmd;
-    // Stores the tmp file index for the output
-    int file;
-    // Stores the Process Id
-    int pid;
-    // Stores the status of a node
-    int status;
-    // Holds the next and previous nodes in a list
-    struct processList* next;
-    struct processList* last;
-} processList;
-
-/* Creates a newProcess allocating memory and setting the default fields
- * then returns a reference to the created node. */
-processList* newProcess(Cmd* cmd, int output, int status);
-
-/* When given a process it is added to the double linked list at the
- * furthest right position. If the list is empty then it is set as the head
- * of the list. */
-void addProcess(processList* toAdd);
-
-/* Removes a given node from the list. When the head is removed
- * the next node takes its place. */
-void removeProcess(processList* toRemove);
-
-/* Prints the output of the command inside the node stored in  the
- * temporary file. Will not do this in the case that a foreground
- * node is stopped and restored as it was never assigned a tmpfile. */
-void printOutput(processList* node);
-
-/* Checks the status of all the processes in the list.
- * Is called at the end of each cycle through the main loop. */
-void checkProcessStatus();
-
-/* Prints the status of every node.
- * Used in the implementation of jobs. */
-void printProcess();
-
-/* Resumed a stopped process given a process id. */
-int resumeProcess(int processID);
-
-/* Deletes the entire list freeing any reserved memory. */
-void removeAllProcesses();
-
+/* Benjamin Schroeder
+ *
+ * processList.h
+ *
+ * The header file for a job table used to track commands and processes not running
+ * in the foreground of the shell. Jobs are stored in a slot array indexed by their job
+ * number, along with a hash map from the OS process id of every stage to its job, so
+ * adding, removing and finding a job by either number takes constant time. Also
+ * implements tracking features inorder to close out of existing processes in an
+ * appropriate way, including stopped processes. Also provides the ability to print
+ * the status of all the commands in the table in job order.
+ */
+
+#ifndef CS352P1_PROCESSLIST_H
+#define CS352P1_PROCESSLIST_H
+
+#include "Cmd.h"
+#include "stream.h"
+#include <sys/types.h>
+
+/* A command and its processes not running in the foreground of the shell. */
+typedef struct Job
+{
+    // Stores the associated command
+    Cmd* cmd;
+    // Stores the tmp file index for the output
+    int file;
+    // Stores the pipe the output is streamed from, or NULL if it goes to file
+    Stream* stream;
+    // Stores the job number, which is also its slot in the table
+    int number;
+    // Stores the status of a job
+    int status;
+    // Set for a job run by a builtin such as parallel, which reports and removes it itself
+    int held;
+    // Set for a background job that streams its output instead of capturing it
+    int streaming;
+    // The priority a queued job is started in, also used as its nice value
+    int priority;
+    // The CPUs the job is allowed to run on, or NULL for any
+    char* cpus;
+    // The order the job was queued in and its position in the queue while Queued
+    unsigned long order;
+    int queueIndex;
+    // Where the exit status is stored once the job is reported, for wait
+    int* exitStatus;
+} Job;
+
+/* The command running in the foreground, which is sent the stop signal
+ * when the user presses 'ctrl + z', or NULL if none exists. */
+extern Cmd* foregroundCmd;
+
+/* Creates a newProcess allocating memory and setting the default fields
+ * then returns a reference to the created job. */
+Job* newProcess(Cmd* cmd, int output, int status);
+
+/* Gives a job the number after the highest in use and adds it to the
+ * table, mapping the process id of every stage to it. */
+void addProcess(Job* toAdd);
+
+/* Maps the process id of every stage of a job that was started after it
+ * was added to the table. */
+void mapStages(Job* job);
+
+/* Changes the status of a job, 0 while running, -2 while stopped and -3
+ * while queued, keeping count of the background jobs that are running. */
+void setProcessStatus(Job* job, int status);
+
+/* Returns the number of background jobs running, not counting stopped and
+ * queued jobs or the tasks of builtins. */
+int runningJobs();
+
+/* Prints how a finished job ended followed by its output if it
+ * completed successfully. */
+void reportProcess(Job* job);
+
+/* Removes a given job from the table, freeing it along with its command.
+ * Job numbers above the highest remaining job become free again. */
+void removeProcess(Job* toRemove);
+
+/* Returns the job with the given job number or NULL if there is none. */
+Job* findJob(int number);
+
+/* Returns the job with a stage running as the given OS process id or
+ * NULL if no job has the process. */
+Job* findProcess(pid_t pid);
+
+/* Copies everything in file to out starting from the beginning of file.
+ * The data is passed with sendfile so it never enters the shell, falling
+ * back to reading and writing large blocks when out does not support it.
+ * Returns the number of bytes copied. */
+off_t replayOutput(int file, int out);
+
+/* Prints the output of the command inside the job stored in  the
+ * temporary file. Will not do this in the case that a foreground
+ * job is stopped and restored as it was never assigned a tmpfile. */
+void printOutput(Job* job);
+
+/* Applies every status change queued by the reaper to the job it belongs
+ * to, found through the process id map so only jobs that changed are looked
+ * at. The foreground command is not in the table and is checked first when
+ * it is given. Finished jobs are reported and removed from the table, apart
+ * from held jobs which are left for their owner.
+ * Returns the number of jobs that were reported. */
+int checkProcessStatus(Cmd* foreground);
+
+/* Sleeps until a child changes state, printing any streamed output that
+ * arrives in the meantime. */
+void waitForChange();
+
+/* Waits for every stage of cmd, which is not in the table, to finish or
+ * for one to be stopped, printing streamed output while it waits. A stopped
+ * command is added to the table. Returns the wait status of the last stage
+ * or -2 if the command was stopped. */
+int waitForeground(Cmd* cmd);
+
+/* Continues the job with the given job number, or the highest one when the
+ * number is 0, and waits for it in the foreground until it is reported or
+ * stopped again. Returns the exit status of the job once it is reported,
+ * 128 plus SIGTSTP if it was stopped again or -1 if there is no such job. */
+int foregroundProcess(int number);
+
+/* Waits for the count jobs with the given job numbers, or every background
+ * job when count is 0, to finish. With any set it returns once the first
+ * of them finishes. While every job waited on has a pidfd the shell sleeps
+ * in poll on exactly those pidfds, otherwise it is woken by any child.
+ * Stopped jobs are not waited for. Returns the exit status of the last job
+ * given or of the first to finish with any, or 127 if a job does not exist. */
+int waitProcesses(int* numbers, int count, int any);
+
+/* Prints the status of every job in job order, followed by the state and
+ * resource usage of each stage when detailed is set.
+ * Used in the implementation of jobs. */
+void printProcess(int detailed);
+
+/* Resumed a stopped job given its job number, or starts a queued job. */
+int resumeProcess(int processID);
+
+/* Deletes the entire table freeing any reserved memory. */
+void removeAllProcesses();
+
+/* Empties the table without touching any job, used by a copy of the shell
+ * as the jobs belong to the original. */
+void forgetProcesses();
+
 #endif //CS352P1_PROCESSLIST_H
\ No newline at end of file
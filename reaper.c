@@ -0,0 +1,128 @@
+/* Benjamin Schroeder
+ *
+ * reaper.c
+ *
+ * The implementation of the SIGCHLD handler used to reap child processes as
+ * soon as they change state. The handler collects every waiting status with
+ * wait4(-1), along with the resources the child used, and pushes it onto a
+ * lock-free queue, so the shell only has to look at the processes that
+ * actually changed instead of checking every process it started. SIGCHLD is
+ * kept blocked except while the shell is waiting, which lets the shell wait
+ * for input or for a foreground command and still be woken the moment a
+ * child exits.
+ */
+
+#define _GNU_SOURCE
+
+#include "reaper.h"
+#include "shellVariables.h"
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <time.h>
+#include <wait.h>
+#include <sys/resource.h>
+
+// A ring buffer written by the handler and read by the main loop
+ChildEvent childEvents[REAP_QUEUE_SIZE];
+atomic_uint eventHead = 0;
+atomic_uint eventTail = 0;
+
+// Set by the handler when it stopped reaping because the queue was full
+volatile sig_atomic_t eventsDropped = 0;
+
+// The signal mask used while waiting, the same as the mask without SIGCHLD
+sigset_t waitMask;
+
+/* Reaps every child with a status change until there are none left or the
+ * queue is full, pushing each status onto the queue. */
+void reapChildren() {
+    int savedErrno = errno;
+
+    while (1) {
+        unsigned int tail = atomic_load_explicit(&eventTail, memory_order_relaxed);
+        unsigned int head = atomic_load_explicit(&eventHead, memory_order_acquire);
+
+        // Children are left unreaped until there is room to store their status
+        if (tail - head == REAP_QUEUE_SIZE) {
+            eventsDropped = 1;
+            break;
+        }
+
+        // wait4 also gives the resources used, which are stored along with the time
+        ChildEvent* event = &childEvents[tail % REAP_QUEUE_SIZE];
+        event->pid = wait4(-1, &event->status, WNOHANG | WUNTRACED | WCONTINUED, &event->usage);
+        if (event->pid <= 0)
+            break;
+
+        clock_gettime(CLOCK_MONOTONIC, &event->time);
+        atomic_store_explicit(&eventTail, tail + 1, memory_order_release);
+    }
+
+    errno = savedErrno;
+}
+
+/* Signal handler for SIGCHLD, which is sent whenever a child exits, is
+ * stopped or is continued. */
+void sigchldHandler(int sig_num) {
+    reapChildren();
+}
+
+/* Installs the SIGCHLD handler and blocks SIGCHLD until the shell waits. */
+void startReaper() {
+    struct sigaction action = {0};
+    action.sa_handler = sigchldHandler;
+    action.sa_flags = SA_RESTART;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGCHLD, &action, NULL);
+
+    sigset_t blocked;
+    sigemptyset(&blocked);
+    sigaddset(&blocked, SIGCHLD);
+    sigprocmask(SIG_BLOCK, &blocked, &waitMask);
+    sigdelset(&waitMask, SIGCHLD);
+}
+
+/* Lets a SIGCHLD that arrived while blocked run the handler. */
+void deliverChildSignals() {
+    sigset_t blocked;
+    sigprocmask(SIG_SETMASK, &waitMask, &blocked);
+    sigprocmask(SIG_SETMASK, &blocked, NULL);
+}
+
+/* Sleeps until the handler has run at least once. */
+void waitForChildSignal() {
+    sigsuspend(&waitMask);
+}
+
+/* Sleeps until one of the count descriptors in fds can be read from or the
+ * handler has run. Returns the number of descriptors ready, with their revents
+ * filled in, or 0 if a child changed state. */
+int waitForEvents(struct pollfd* fds, int count) {
+    int ready = ppoll(fds, count, NULL, &waitMask);
+
+    return ready == -1 ? 0 : ready;
+}
+
+/* Takes the oldest status change off the queue, copying it into event.
+ * Returns 0 if the queue is empty. */
+int nextChildEvent(ChildEvent* event) {
+    unsigned int head = atomic_load_explicit(&eventHead, memory_order_relaxed);
+    unsigned int tail = atomic_load_explicit(&eventTail, memory_order_acquire);
+
+    if (head == tail) {
+        // Children left behind by a full queue are reaped now that it has room
+        if (eventsDropped) {
+            eventsDropped = 0;
+            reapChildren();
+            return nextChildEvent(event);
+        }
+        return 0;
+    }
+
+    *event = childEvents[head % REAP_QUEUE_SIZE];
+    atomic_store_explicit(&eventHead, head + 1, memory_order_release);
+
+    return 1;
+}
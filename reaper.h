@@ -0,0 +1,52 @@
+/* Benjamin Schroeder
+ *
+ * reaper.h
+ *
+ * The header file for the SIGCHLD handler used to reap child processes as
+ * soon as they change state. The handler collects every waiting status with
+ * wait4(-1), along with the resources the child used, and pushes it onto a
+ * lock-free queue, so the shell only has to look at the processes that
+ * actually changed instead of checking every process it started. SIGCHLD is
+ * kept blocked except while the shell is waiting, which lets the shell wait
+ * for input or for a foreground command and still be woken the moment a
+ * child exits.
+ */
+
+#ifndef CS352P1_REAPER_H
+#define CS352P1_REAPER_H
+
+#include <sys/types.h>
+#include <poll.h>
+#include <time.h>
+#include <sys/resource.h>
+
+/* A status change of a child, as reported by wait4. */
+typedef struct ChildEvent {
+    pid_t pid;
+    /* The status given by wait4. */
+    int status;
+    /* The resources used by the child, only filled in once it has exited. */
+    struct rusage usage;
+    /* When the change was reaped, from the monotonic clock. */
+    struct timespec time;
+} ChildEvent;
+
+/* Installs the SIGCHLD handler and blocks SIGCHLD until the shell waits. */
+void startReaper();
+
+/* Lets a SIGCHLD that arrived while blocked run the handler. */
+void deliverChildSignals();
+
+/* Sleeps until the handler has run at least once. */
+void waitForChildSignal();
+
+/* Sleeps until one of the count descriptors in fds can be read from or the
+ * handler has run. Returns the number of descriptors ready, with their revents
+ * filled in, or 0 if a child changed state. */
+int waitForEvents(struct pollfd* fds, int count);
+
+/* Takes the oldest status change off the queue, copying it into event.
+ * Returns 0 if the queue is empty. */
+int nextChildEvent(ChildEvent* event);
+
+#endif //CS352P1_REAPER_H
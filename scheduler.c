@@ -0,0 +1,238 @@
+/* Benjamin Schroeder
+ *
+ * scheduler.c
+ *
+ * The implementation of the admission queue of background jobs. A limit on
+ * the number of background jobs running at once can be set with 'bg --max',
+ * jobs started beyond it are Queued in a binary heap ordered by priority
+ * and then by the order they were queued, and the next one is started as
+ * soon as a running job finishes or is stopped. A job can also be given a
+ * priority, used as its nice value, and the CPUs it may run on, which every
+ * stage applies to itself before it executes.
+ */
+
+#define _GNU_SOURCE
+
+#include "scheduler.h"
+#include "launch.h"
+#include <errno.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+
+int maxRunningJobs = 0;
+
+// The binary heap of queued jobs, the first to start at the top
+Job** queue = NULL;
+int queueSize = 0;
+int queueCapacity = 0;
+
+// Counts the jobs queued so those of the same priority start in order
+unsigned long queued = 0;
+
+/* Returns 1 if job a should be started before job b. */
+int startsBefore(Job* a, Job* b) {
+    return a->priority != b->priority ? a->priority < b->priority : a->order < b->order;
+}
+
+/* Puts a job at a position in the heap, keeping its index up to date. */
+void placeJob(int index, Job* job) {
+    queue[index] = job;
+    job->queueIndex = index;
+}
+
+/* Moves the job at index up the heap until its parent starts before it. */
+void siftUp(int index) {
+    Job* job = queue[index];
+
+    while (index > 0 && startsBefore(job, queue[(index - 1) / 2])) {
+        placeJob(index, queue[(index - 1) / 2]);
+        index = (index - 1) / 2;
+    }
+    placeJob(index, job);
+}
+
+/* Moves the job at index down the heap until it starts before its children. */
+void siftDown(int index) {
+    Job* job = queue[index];
+
+    while (index * 2 + 1 < queueSize) {
+        int child = index * 2 + 1;
+        if (child + 1 < queueSize && startsBefore(queue[child + 1], queue[child]))
+            child++;
+        if (!startsBefore(queue[child], job))
+            break;
+
+        placeJob(index, queue[child]);
+        index = child;
+    }
+    placeJob(index, job);
+}
+
+/* Removes a queued job from the queue without starting it. */
+void unqueueProcess(Job* job) {
+    int index = job->queueIndex;
+    Job* last = queue[--queueSize];
+
+    // No longer Queued, so removing the job before it is running does not take it out of the queue again
+    setProcessStatus(job, -1);
+
+    // The last job takes the place of the one removed and is moved to where it belongs
+    if (index < queueSize) {
+        placeJob(index, last);
+        siftDown(index);
+        siftUp(last->queueIndex);
+    }
+}
+
+/* Reads a CPU list such as '0,2-3' into cpus.
+ * Returns -1 if it is malformed or names a CPU that does not exist. */
+int readCpuList(const char* list, cpu_set_t* cpus) {
+    long online = sysconf(_SC_NPROCESSORS_CONF);
+    CPU_ZERO(cpus);
+
+    while (*list != '\0') {
+        char* end;
+        long first = strtol(list, &end, 10);
+        long last = first;
+
+        if (end == list)
+            return -1;
+        if (*end == '-') {
+            list = end + 1;
+            last = strtol(list, &end, 10);
+            if (end == list)
+                return -1;
+        }
+        if (first < 0 || last < first || last >= online || last >= CPU_SETSIZE)
+            return -1;
+
+        for (long cpu = first; cpu <= last; cpu++)
+            CPU_SET(cpu, cpus);
+
+        if (*end == ',')
+            end++;
+        else if (*end != '\0')
+            return -1;
+        list = end;
+    }
+
+    return 0;
+}
+
+/* Checks a CPU list such as '0,2-3'. Returns -1 if it is malformed or
+ * names a CPU that does not exist. */
+int checkCpuList(const char* list) {
+    cpu_set_t cpus;
+    return readCpuList(list, &cpus);
+}
+
+/* Starts a job in the table that has not been started yet, capturing or
+ * streaming its output and applying its priority and CPUs. The job is
+ * removed after printing a message if it cannot be started.
+ * Returns 0 if started or -1 on failure. */
+int startProcess(Job* job) {
+    int streamEnd = -1;
+    int output = job->streaming ? openStream(&streamEnd) : memfd_create("tmp", MFD_CLOEXEC);
+
+    // Each stage sets the priority and CPUs itself before it executes, so whatever it starts has them too
+    cpu_set_t cpus;
+    int pinned = job->cpus != NULL && readCpuList(job->cpus, &cpus) == 0;
+    int nice = job->priority < -20 ? -20 : job->priority > 19 ? 19 : job->priority;
+    setPlacement(nice, pinned ? &cpus : NULL);
+
+    int started = output != -1 && startPipeline(job->cmd, STDIN_FILENO, output) != -1;
+    Placement applied = placement;
+    setPlacement(0, NULL);
+
+    // A failure leaves the stages running as they are
+    if (applied.niceError != 0)
+        fprintf(stderr, "bg: cannot set priority %d: %s\n", nice, strerror(applied.niceError));
+    if (applied.cpusError != 0)
+        fprintf(stderr, "bg: cannot set cpus %s: %s\n", job->cpus, strerror(applied.cpusError));
+
+    if (!started) {
+        printf("[%d] Could not start %s", job->number, job->cmd->line);
+        if (output != -1)
+            close(output);
+        if (streamEnd != -1)
+            close(streamEnd);
+        removeProcess(job);
+        return -1;
+    }
+
+    // A job none of whose stages started is never reaped, so it is reported and removed now
+    if (runningStages(job->cmd) == 0) {
+        close(output);
+        if (streamEnd != -1)
+            close(streamEnd);
+        reportProcess(job);
+        removeProcess(job);
+        return 0;
+    }
+
+    // Only the job holds the write end of a stream so the stream ends when the job does
+    if (job->streaming) {
+        close(output);
+        job->file = STDOUT_FILENO;
+        job->stream = watchStream(streamEnd, job->number);
+    } else {
+        job->file = output;
+    }
+
+    mapStages(job);
+    setProcessStatus(job, 0);
+    printf("[%d] %d\n", job->number, job->cmd->pid);
+
+    return 0;
+}
+
+/* Starts queued jobs in order until the limit of running jobs is reached. */
+void admitProcesses() {
+    while (queueSize > 0 && (maxRunningJobs == 0 || runningJobs() < maxRunningJobs)) {
+        Job* job = queue[0];
+        unqueueProcess(job);
+        startProcess(job);
+    }
+}
+
+/* Adds a background job that has not been started to the table, starting
+ * it right away if there is room and it is first in the queue, otherwise
+ * leaving it Queued. Prints the job number with its process id once started
+ * or with Queued. Returns 1 if started, 0 if queued or -1 on failure. */
+int queueProcess(Job* job) {
+    job->status = -3;
+    job->order = queued++;
+    addProcess(job);
+    int number = job->number;
+
+    if (queueSize == queueCapacity) {
+        queueCapacity = queueCapacity == 0 ? 16 : queueCapacity * 2;
+        queue = (Job**) realloc(queue, sizeof(Job*) * queueCapacity);
+    }
+    placeJob(queueSize++, job);
+    siftUp(queueSize - 1);
+
+    admitProcesses();
+
+    // The job may have been removed if it could not be started
+    if (findJob(number) != job)
+        return -1;
+    if (job->status == -3) {
+        printf("[%d] Queued\n", number);
+        return 0;
+    }
+    return 1;
+}
+
+/* Empties the queue without touching any job, used by a copy of the shell
+ * as the jobs belong to the original. */
+void forgetQueue() {
+    queue = NULL;
+    queueSize = 0;
+    queueCapacity = 0;
+}
@@ -0,0 +1,48 @@
+/* Benjamin Schroeder
+ *
+ * scheduler.h
+ *
+ * The header file for the admission queue of background jobs. A limit on
+ * the number of background jobs running at once can be set with 'bg --max',
+ * jobs started beyond it are Queued in a binary heap ordered by priority
+ * and then by the order they were queued, and the next one is started as
+ * soon as a running job finishes or is stopped. A job can also be given a
+ * priority, used as its nice value, and the CPUs it may run on, which every
+ * stage applies to itself before it executes.
+ */
+
+#ifndef CS352P1_SCHEDULER_H
+#define CS352P1_SCHEDULER_H
+
+#include "processList.h"
+
+/* The most background jobs running at once, or 0 for no limit. */
+extern int maxRunningJobs;
+
+/* Adds a background job that has not been started to the table, starting
+ * it right away if there is room and it is first in the queue, otherwise
+ * leaving it Queued. Prints the job number with its process id once started
+ * or with Queued. Returns 1 if started, 0 if queued or -1 on failure. */
+int queueProcess(Job* job);
+
+/* Starts a job in the table that has not been started yet, capturing or
+ * streaming its output and applying its priority and CPUs. The job is
+ * removed after printing a message if it cannot be started.
+ * Returns 0 if started or -1 on failure. */
+int startProcess(Job* job);
+
+/* Starts queued jobs in order until the limit of running jobs is reached. */
+void admitProcesses();
+
+/* Removes a queued job from the queue without starting it. */
+void unqueueProcess(Job* job);
+
+/* Empties the queue without touching any job, used by a copy of the shell
+ * as the jobs belong to the original. */
+void forgetQueue();
+
+/* Checks a CPU list such as '0,2-3'. Returns -1 if it is malformed or
+ * names a CPU that does not exist. */
+int checkCpuList(const char* list);
+
+#endif //CS352P1_SCHEDULER_H
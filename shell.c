@@ -22,127 +22,351 @@
 #include <sys/mman.h>
 #include <signal.h>
 #include <wait.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include <sys/resource.h>
 
 #include "processList.h"
-
-/* The process of the currently executing foreground command, or 0
- * if none exists. */
-pid_t foregroundPid = 0;
-/* Stores a reference to the Cmd that is currently being executed in
- * the foreground. */
-Cmd* foregroundCmd = NULL;
+#include "pathCache.h"
+#include "reaper.h"
+#include "stream.h"
+#include "builtins.h"
+#include "scheduler.h"
+#include "trace.h"
+#include "stats.h"
+#include "zygote.h"
+#include "plan.h"
+#include "vars.h"
+#include "expand.h"
+#include "substitute.h"
 
 /* Signal handler for SIGTSTP (SIGnal - Terminal SToP),
  * which is caused by the user pressing control+z. */
 void sigtstpHandler(int sig_num) {
 	/* Reset handler to catch next SIGTSTP. */
 	signal(SIGTSTP, sigtstpHandler);
-	if (foregroundPid > 0) {
-		/* Forward SIGTSTP to the currently running foreground process. */
-		kill(foregroundPid, SIGTSTP);
-
-        if (foregroundCmd != NULL) {
-            // Adds the command to the process list
-            processList* new = newProcess(foregroundCmd, STDOUT_FILENO, -2);
-            addProcess(new);
-        }
+	if (foregroundCmd != NULL) {
+        /* Forward SIGTSTP to every stage of the foreground pipeline.
+         * It is added to the process list once the reaper reports it
+         * stopped. */
+        signalPipeline(foregroundCmd, SIGTSTP);
 	}
 }
 
-/* The main process loop of the shell. Repeatedly prompts users
- * for an input and processes it. also listens for a 'ctrl + z'
- * input. */
-int main(void) {
-	/* Listen for control+z (suspend process). */
-	signal(SIGTSTP, sigtstpHandler);
+// Holds the incoming line, grown by getline to fit the longest line read
+char* line = NULL;
+size_t lineSize = 0;
 
-	while (1) {
-		// Prompts the user for input
-	    printf("\n352> ");
-		fflush(stdout);
+// Holds the lines of a command that is not finished yet, such as a loop being typed
+char* pending = NULL;
+size_t pendingLength = 0;
+size_t pendingSize = 0;
+
+// The command being processed, kept between lines unless it is handed to the process list
+Cmd *cmd = NULL;
+
+/* Frees the line and command when the shell exits, including through the
+ * exit builtin. */
+void freeShell() {
+    if (cmd != NULL)
+        freeCmd(cmd);
+    free(line);
+    free(pending);
+}
 
-		// Allocates space for the incoming command
-		Cmd *cmd = (Cmd*) calloc(1, sizeof(Cmd));
+/* Adds the length bytes of text to the end of the pending lines. */
+void appendPending(const char* text, size_t length) {
+    if (pendingLength + length > pendingSize) {
+        pendingSize = (pendingLength + length) * 2;
+        pending = realloc(pending, pendingSize);
+    }
 
-		// Grabs the command in the form of a string
-		fgets(cmd->line, MAX_LINE, stdin);
+    memcpy(pending + pendingLength, text, length);
+    pendingLength += length;
+}
 
-		// Parses the command from a string into arguments
-		parseCmd(cmd);
+/* Executes a single pipeline of a plan, with status the status of the plan
+ * so far. Background processes that changed while the pipeline ran are
+ * reported afterwards. Returns the exit status of the pipeline, or
+ * PLAN_STOPPED if it was stopped so the rest of the plan is not run. */
+int runPipeline(const Pipeline* pipeline, int status) {
+    // Variables such as $? see the status the plan has reached
+    lastStatus = status;
 
-		// Uses if statements to begin seeing how to deal with the command
+    // Allocates space for the incoming command
+    if (cmd == NULL)
+        cmd = newCmd();
 
-		/* if the command is empty free allocated space */
-		if (!cmd->args[0]) {
-			free(cmd);
+    // Copies the pipeline out of the plan, which is shared with the parse cache, and expands it
+    substitutionStatus = 0;
+    loadPipeline(cmd, pipeline);
 
-        /* when exit is entered free allocated space then exit the command */
-		} else if (strcmp(cmd->args[0], "exit") == 0) {
-            free(cmd);
-            removeAllProcesses();
-            exit(0);
+    // The arguments of the first command are used to find builtins, a command of only variables may expand to nothing
+    char** args = cmd->pipeline->stageCount > 0 && cmd->pipeline->stages[0].argCount > 0 ? cmd->pipeline->stages[0].args : NULL;
 
-        /* if jobs is entered prints the status of all background commands */
-        } else if (strcmp(cmd->args[0], "jobs") == 0) {
-		    printProcess();
-            free(cmd);
+    // Builtins given alone in the foreground run inside the shell, unless timed as only a process can be
+    Builtin builtin = NULL;
+    if (args != NULL)
+        builtin = onlyAssignments(args) ? assignVariables : findBuiltin(args[0]);
+    if (builtin != NULL && (cmd->pipeline->background || cmd->pipeline->stageCount > 1 || cmd->pipeline->timed))
+        builtin = NULL;
 
-        /* Resumes a stopped process with a corresponding process id */
-        } else if (strcmp(cmd->args[0], "bg") == 0) {
-            if (cmd->args[1] != NULL) {
-                int status = resumeProcess(atoi(cmd->args[1]));
-                if (status == 1) {
-                    printf("Could Not Resume Command\n");
-                }
-            }
-            free(cmd);
+    if (args != NULL)
+        stats.commands++;
 
-        /* Otherwise begins to execute the command as a linux command */
-		} else {
-		    // Creates variables inorder to determine how to execute
-		    int input = STDIN_FILENO;
-		    int output = STDOUT_FILENO;
-		    int background = findSymbol(cmd, BG_OP);
-
-		    // Sets the output to a tmpfile if its a background command
-            if (background != -1) {
-                output = memfd_create("tmp", O_RDWR);
+    // Uses if statements to begin seeing how to deal with the command
+
+    /* an empty command does nothing */
+    if (args == NULL) {
+        status = lastStatus;
+
+    /* Runs the builtin without starting a process */
+    } else if (builtin != NULL) {
+        status = runBuiltin(builtin, &cmd->pipeline->stages[0]);
+        fflush(stdout);
+
+    /* Background commands are handed to the scheduler, which starts them once there is room */
+    } else if (cmd->pipeline->background) {
+        Job* new = newProcess(cmd, STDOUT_FILENO, 0);
+        new->streaming = streamEnabled;
+        status = queueProcess(new) == -1 ? 1 : 0;
+        cmd = NULL;
+
+    /* Otherwise begins to execute the command as a linux command */
+    } else {
+        // Starts every stage of the command directly from the shell
+        if (startPipeline(cmd, STDIN_FILENO, STDOUT_FILENO) == -1) {
+            status = 1;
+
+        // The shell waits for the command in the foreground
+        } else {
+            // Waits for every stage to finish, a stopped command is added to the process list
+            int wait = waitForeground(cmd);
+            if (wait == -2) {
+                status = PLAN_STOPPED;
+                cmd = NULL;
+            } else {
+                status = exitCode(wait);
+                if (cmd->pipeline->timed)
+                    printTime(cmd);
             }
+        }
+    }
+    // Releases the memory of a finished command so it can hold the next line
+    if (cmd != NULL)
+        resetCmd(cmd);
+
+    // Reports background processes that changed while the command ran
+    checkProcessStatus(NULL);
+
+    // Builtins run later in the plan see the status of this pipeline
+    if (status != PLAN_STOPPED)
+        lastStatus = status;
+    return status;
+}
+
+/* Compiles and executes the length bytes of text, which need not end in a
+ * newline and may hold many commands over many lines. Sets lastStatus to
+ * the exit status of the text, or 2 if it is malformed.
+ * Returns PLAN_INCOMPLETE without running anything if the text ends in the
+ * middle of a command, otherwise PLAN_COMPLETE or PLAN_ERROR. */
+int runLine(const char* text, size_t length) {
+    Plan* plan;
+    int result = loadPlan(text, length, &plan);
+
+    if (result == PLAN_INCOMPLETE)
+        return result;
+
+    if (result == PLAN_ERROR) {
+        lastStatus = 2;
+    } else {
+        // A stopped pipeline ends the plan with the status of a stopped process
+        int status = runPlan(plan, runPipeline, lastStatus);
+        lastStatus = status == PLAN_STOPPED ? 128 + SIGTSTP : status;
+        releasePlan(plan);
+    }
 
-            //Forks the process and begins execution of the command
-            cmd->pid = fork();
+    // The events of the line are written before the next is read
+    flushTrace();
 
-            if (cmd->pid == 0) {
-                dup2(output, 1);
-                callCmd(cmd, input, output);
+    return result;
+}
+
+/* Runs every line of the length bytes in text without prompting, as given
+ * to -c or read from a script. A command spanning many lines is run once
+ * all of them are read. Returns the exit status of the last command. */
+int runText(const char* text, size_t length) {
+    const char* end = text + length;
+    const char* next = text;
+    PlanScan scan = {0};
+    int scanning = 1;
+
+    while (next < end) {
+        const char* newline = memchr(next, '\n', end - next);
+        next = newline != NULL ? newline + 1 : end;
+
+        // Lines are added until the command they start is finished, only the new lines are scanned until then
+        if ((scanning && !scanPlan(&scan, text, next - text)) || runLine(text, next - text) == PLAN_INCOMPLETE) {
+            // A block left open is compiled again a line at a time so an error inside it is reported where it is
+            if (next == end && scanning) {
+                scanning = 0;
+                next = text;
             }
+            continue;
+        }
+        text = next;
+        resetPlanScan(&scan);
+    }
+    freePlanScan(&scan);
+
+    // The text ended in the middle of a command
+    if (text < end) {
+        printf("Syntax error: unexpected end of input\n");
+        lastStatus = 2;
+    }
+
+    fflush(stdout);
+    return lastStatus;
+}
 
-            // If the process is to run in the foreground the parent waits
-			if (background == -1) {
-			    // Foreground variables are set
-			    foregroundPid = cmd->pid;
-			    foregroundCmd = cmd;
-
-			    // Waits for child to finish or be stopped
-			    int status = waitpid(cmd->pid, NULL, WUNTRACED);
-
-                // Frees child command if exited without interrupt
-                if (status == foregroundCmd->pid)
-                    free(foregroundCmd);
-
-                // Resets foreground variables
-                foregroundCmd = NULL;
-                foregroundCmd = 0;
-			} else {
-			    // Adds command to the background list
-			    processList* new = newProcess(cmd, output, 0);
-			    printf("[%d] %d\n", new->pid, cmd->pid);
-                addProcess(new);
-			}
+/* Runs a script file, mapped into memory so it is read without copying.
+ * Returns the exit status of the last line or 127 if it cannot be read. */
+int runScript(const char* path) {
+    int file = open(path, O_RDONLY|O_CLOEXEC);
+    struct stat info;
+
+    if (file == -1 || fstat(file, &info) == -1) {
+        fprintf(stderr, "shell352: %s: %s\n", path, strerror(errno));
+        return 127;
+    }
+
+    // An empty script cannot be mapped and has nothing to run
+    if (info.st_size == 0) {
+        close(file);
+        return 0;
+    }
+
+    char* text = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+    close(file);
+    if (text == MAP_FAILED) {
+        fprintf(stderr, "shell352: %s: %s\n", path, strerror(errno));
+        return 127;
+    }
+
+    madvise(text, info.st_size, MADV_SEQUENTIAL);
+    int status = runText(text, info.st_size);
+    munmap(text, info.st_size);
+
+    return status;
+}
+
+/* The main process loop of the shell. Runs the command given with -c or the
+ * script given as an argument, otherwise repeatedly prompts users for an
+ * input and processes it. also listens for a 'ctrl + z' input. */
+int main(int argc, char** argv) {
+	/* Options come before -c or a script. The zygote is forked before anything else so it stays small. */
+	int first = 1;
+	int statsOnExit = 0;
+	for (; first < argc && strncmp(argv[first], "--", 2) == 0; first++) {
+	    if (strcmp(argv[first], STATS_ON_EXIT_FLAG) == 0) {
+	        statsOnExit = 1;
+	    } else if (strcmp(argv[first], ZYGOTE_FLAG) == 0) {
+	        startZygote();
+	    } else {
+	        fprintf(stderr, "usage: shell352 [--stats-on-exit] [--zygote] [-c command | script]\n");
+	        return 2;
+	    }
+	}
+
+	/* The environment becomes the exported variables of the shell. */
+	importEnvironment(environ);
+
+	/* Commands substituted into words are run by a copy of the shell the same as -c text. */
+	substitutionRunner = runText;
+
+	/* Listen for control+z (suspend process). */
+	signal(SIGTSTP, sigtstpHandler);
+
+	/* Reap children as soon as they change state. */
+	startReaper();
+
+	/* Every running stage holds a pidfd, so allow as many descriptors as possible. */
+	struct rlimit files;
+	if (getrlimit(RLIMIT_NOFILE, &files) == 0 && files.rlim_cur < files.rlim_max) {
+	    files.rlim_cur = files.rlim_max;
+	    setrlimit(RLIMIT_NOFILE, &files);
+	}
+
+	atexit(freeShell);
+
+	/* Trace from the start when a trace file is given in the environment. */
+	const char* tracePath = getVariable(TRACE_VARIABLE);
+	if (tracePath != NULL && tracePath[0] != '\0')
+	    startTrace(tracePath);
+	atexit(stopTrace);
+
+	/* Prints the counters to stderr on the way out, for batch runs. */
+	if (statsOnExit)
+	    atexit(printExitStats);
+
+	// Commands given on the command line are run without a prompt
+	if (argc > first) {
+	    int status;
+
+	    if (strcmp(argv[first], "-c") == 0 && argc > first + 1) {
+	        status = runText(argv[first + 1], strlen(argv[first + 1]));
+	    } else if (argv[first][0] != '-') {
+	        status = runScript(argv[first]);
+	    } else {
+	        fprintf(stderr, "usage: shell352 [--stats-on-exit] [--zygote] [-c command | script]\n");
+	        return 2;
+	    }
+
+	    removeAllProcesses();
+	    exit(status);
+	}
+
+	while (1) {
+		// Prompts the user for input, or for the rest of a command that is not finished
+	    const char* prompt = pendingLength > 0 ? "> " : "\n352> ";
+	    printf("%s", prompt);
+		fflush(stdout);
+
+		// Background commands finishing or streaming output while waiting at a terminal are shown right away
+		uint64_t start = traceClock();
+		if (isatty(STDIN_FILENO)) {
+		    struct pollfd events[2];
+		    do {
+		        events[0] = (struct pollfd) {STDIN_FILENO, POLLIN, 0};
+		        events[1] = (struct pollfd) {streamPollFd(), POLLIN, 0};
+		        waitForEvents(events, 2);
+
+		        if (drainStreams() + checkProcessStatus(NULL) > 0) {
+		            printf("%s", prompt);
+		            fflush(stdout);
+		        }
+		    } while (events[0].revents == 0);
 		}
-		// Runs a check on background processes
-		checkProcessStatus();
+		traceSpan("prompt", start, NULL, 0);
 
+		// Grabs the command in the form of a string, the end of input is treated as exit
+		start = traceClock();
+		ssize_t length = getline(&line, &lineSize, stdin);
+		traceSpan("read", start, "bytes", length);
+		if (length == -1) {
+		    removeAllProcesses();
+		    exit(lastStatus);
+		}
+
+		// Lines are held until the command they start is finished
+		if (pendingLength == 0) {
+		    if (runLine(line, length) == PLAN_INCOMPLETE)
+		        appendPending(line, length);
+		} else {
+		    appendPending(line, length);
+		    if (runLine(pending, pendingLength) != PLAN_INCOMPLETE)
+		        pendingLength = 0;
+		}
 	}
 	return 0;
 }
@@ -1,20 +1,75 @@
-/* Benjamin Schroeder
- *
- * shellVariables
- *
- * A file created for the convenience of having shell variables stored
- * in an importable class, allowing for their global usage while only
- * needing to modify one file inorder to modify shell parameters.
- */
-
-#ifndef CS352P1_SHELLVARIABLES_H
-#define CS352P1_SHELLVARIABLES_H
-
-#define MAX_LINE 80
-#define MAX_ARGS (MAX_LINE/2 + 1)
-#define REDIRECT_OUT_OP '>'
-#define REDIRECT_IN_OP '<'
-#define PIPE_OP '|'
-#define BG_OP '&'
-
-#endif //CS352P1_SHELLVARIABLES_H
+/* Benjamin Schroeder
+ *
+ * shellVariables
+ *
+ * A file created for the convenience of having shell variables stored
+ * in an importable class, allowing for their global usage while only
+ * needing to modify one file inorder to modify shell parameters.
+ */
+
+#ifndef CS352P1_SHELLVARIABLES_H
+#define CS352P1_SHELLVARIABLES_H
+
+#define REDIRECT_OUT_OP '>'
+#define REDIRECT_IN_OP '<'
+#define PIPE_OP '|'
+#define BG_OP '&'
+#define SEQ_OP ';'
+#define NEWLINE_OP '\n'
+// Operators of more than one character are given a character of their own
+#define AND_OP 'A'
+#define OR_OP 'O'
+#define APPEND_OP 'P'
+#define READ_WRITE_OP 'W'
+#define DUP_OUT_OP 'D'
+#define DUP_IN_OP 'U'
+#define ALL_OUT_OP 'L'
+#define ALL_APPEND_OP 'M'
+#define HERE_STRING_OP 'H'
+// Written around the name of a variable within a word so it is expanded when run
+#define EXPAND_MARK '\001'
+#define QUOTED_EXPAND_MARK '\002'
+#define EXPAND_END '\003'
+// Written before each unquoted '*', '?' and '[' so the word is matched against files
+#define PATTERN_MARK '\004'
+// Written around the text of a $(...) or `...` command within a word, ended by EXPAND_END
+#define SUBSTITUTE_MARK '\005'
+#define QUOTED_SUBSTITUTE_MARK '\006'
+#define TIME_KEYWORD "time"
+#define FOR_KEYWORD "for"
+#define IN_KEYWORD "in"
+#define WHILE_KEYWORD "while"
+#define UNTIL_KEYWORD "until"
+#define DO_KEYWORD "do"
+#define DONE_KEYWORD "done"
+#define IF_KEYWORD "if"
+#define THEN_KEYWORD "then"
+#define ELIF_KEYWORD "elif"
+#define ELSE_KEYWORD "else"
+#define FI_KEYWORD "fi"
+#define PATH_CACHE_SIZE 256
+#define ARENA_BLOCK_SIZE 4096
+#define REAP_QUEUE_SIZE 1024
+#define REPLAY_BUFFER_SIZE (1 << 20)
+#define STREAM_LINE_SIZE 4096
+#define TRACE_BUFFER_SIZE 4096
+#define STATS_SUB_BITS 3
+#define STATS_BUCKETS 320
+#define STATS_ON_EXIT_FLAG "--stats-on-exit"
+#define ZYGOTE_FLAG "--zygote"
+#define PARSE_CACHE_SIZE 1024
+#define PARSE_CACHE_BUCKETS 2048
+#define PARSE_CACHE_LINE_LIMIT 4096
+#define ZYGOTE_STACK_SIZE (64 * 1024)
+#define SPAWN_STACK_SIZE (64 * 1024)
+#define TRACE_VARIABLE "SHELL352_TRACE"
+#define TRACE_DEFAULT_FILE "shell352.trace.json"
+#define VARIABLE_TABLE_SIZE 256
+#define DEFAULT_IFS " \t\n"
+#define GLOB_CACHE_SIZE 64
+#define GLOB_READ_SIZE (1 << 20)
+#define SUBSTITUTE_READ_SIZE (64 * 1024)
+#define SUBSTITUTE_PIPE_SIZE (1 << 20)
+#define REDIRECT_FILE_MODE 0666
+
+#endif //CS352P1_SHELLVARIABLES_H
@@ -0,0 +1,132 @@
+/* Benjamin Schroeder
+ *
+ * stats.c
+ *
+ * The implementation of the running counters of the shell. Commands run,
+ * processes forked and executed, failed executions, pipes created, bytes of
+ * background output captured and children reaped are counted in one fixed
+ * structure, along with histograms of how long each stage took to start and
+ * how long each command ran. Nothing is allocated while counting so the
+ * counters can stay on all the time. They are printed by the 'stats' builtin
+ * and to stderr when the shell exits if given '--stats-on-exit'.
+ */
+
+#include "stats.h"
+#include <string.h>
+#include <time.h>
+
+Stats stats;
+
+// How many buckets each power of two is split into
+#define STATS_SUB_BUCKETS (1 << STATS_SUB_BITS)
+
+/* Returns the monotonic clock in nanoseconds. */
+uint64_t statsClock() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t) now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+/* Returns the bucket holding a time in microseconds. Small times have a
+ * bucket each, larger ones are placed by their highest bit and the bits
+ * just below it. */
+int bucketOf(uint64_t value) {
+    if (value < STATS_SUB_BUCKETS)
+        return (int) value;
+
+    int shift = 63 - __builtin_clzll(value) - STATS_SUB_BITS;
+    int bucket = shift * STATS_SUB_BUCKETS + (int) (value >> shift);
+
+    return bucket < STATS_BUCKETS ? bucket : STATS_BUCKETS - 1;
+}
+
+/* Returns the largest time in microseconds held by a bucket. */
+uint64_t bucketLimit(int bucket) {
+    if (bucket < STATS_SUB_BUCKETS)
+        return bucket;
+
+    int shift = bucket / STATS_SUB_BUCKETS - 1;
+    uint64_t mantissa = bucket % STATS_SUB_BUCKETS + STATS_SUB_BUCKETS;
+    return ((mantissa + 1) << shift) - 1;
+}
+
+/* Adds a time given in nanoseconds to a histogram. */
+void recordLatency(Histogram* histogram, uint64_t nanoseconds) {
+    uint64_t micros = nanoseconds / 1000;
+
+    histogram->count++;
+    histogram->total += micros;
+    if (micros > histogram->max)
+        histogram->max = micros;
+    histogram->buckets[bucketOf(micros)]++;
+}
+
+/* Returns the upper bound in microseconds of the bucket holding the given
+ * fraction of the times of a histogram, or 0 if it is empty. */
+uint64_t histogramPercentile(const Histogram* histogram, double fraction) {
+    if (histogram->count == 0)
+        return 0;
+
+    // The rank of the time wanted, counting from 1
+    uint64_t rank = (uint64_t) (fraction * histogram->count + 0.5);
+    if (rank == 0)
+        rank = 1;
+
+    uint64_t seen = 0;
+    for (int i = 0; i < STATS_BUCKETS; i++) {
+        seen += histogram->buckets[i];
+        if (seen >= rank)
+            return bucketLimit(i) < histogram->max ? bucketLimit(i) : histogram->max;
+    }
+    return histogram->max;
+}
+
+/* Prints the summary of a histogram as 'name_count', 'name_mean' and so on. */
+void printHistogram(FILE* out, const char* name, const Histogram* histogram) {
+    fprintf(out, "%s_count %lu\n", name, histogram->count);
+    fprintf(out, "%s_mean %lu\n", name, histogram->count > 0 ? histogram->total / histogram->count : 0);
+    fprintf(out, "%s_p50 %lu\n", name, histogramPercentile(histogram, 0.50));
+    fprintf(out, "%s_p90 %lu\n", name, histogramPercentile(histogram, 0.90));
+    fprintf(out, "%s_p99 %lu\n", name, histogramPercentile(histogram, 0.99));
+    fprintf(out, "%s_max %lu\n", name, histogram->max);
+}
+
+/* Prints every counter to out as 'name value' lines. */
+void printStats(FILE* out) {
+    fprintf(out, "commands %lu\n", stats.commands);
+    fprintf(out, "forks %lu\n", stats.forks);
+    fprintf(out, "execs %lu\n", stats.execs);
+    fprintf(out, "exec_failures %lu\n", stats.execFailures);
+    fprintf(out, "pipes %lu\n", stats.pipes);
+    fprintf(out, "captured_bytes %lu\n", stats.capturedBytes);
+    fprintf(out, "reaped %lu\n", stats.reaped);
+    fprintf(out, "jobs_done %lu\n", stats.jobsDone);
+    fprintf(out, "parse_cache_hits %lu\n", stats.parseHits);
+    fprintf(out, "parse_cache_misses %lu\n", stats.parseMisses);
+    fprintf(out, "parse_cache_evictions %lu\n", stats.parseEvictions);
+    fprintf(out, "glob_cache_hits %lu\n", stats.globHits);
+    fprintf(out, "glob_directory_reads %lu\n", stats.globReads);
+    printHistogram(out, "launch_us", &stats.launchTime);
+    printHistogram(out, "command_us", &stats.commandTime);
+}
+
+/* Prints the counters to stderr, registered with atexit by '--stats-on-exit'. */
+void printExitStats() {
+    printStats(stderr);
+}
+
+/* Prints the counters, or with -r sets them all back to zero. */
+int builtinStats(char** args) {
+    if (args[1] != NULL && strcmp(args[1], "-r") == 0) {
+        memset(&stats, 0, sizeof(Stats));
+        return 0;
+    }
+
+    if (args[1] != NULL) {
+        fprintf(stderr, "stats: usage: stats [-r]\n");
+        return 2;
+    }
+
+    printStats(stdout);
+    return 0;
+}
@@ -0,0 +1,80 @@
+/* Benjamin Schroeder
+ *
+ * stats.h
+ *
+ * The header file for the running counters of the shell. Commands run,
+ * processes forked and executed, failed executions, pipes created, bytes of
+ * background output captured and children reaped are counted in one fixed
+ * structure, along with histograms of how long each stage took to start and
+ * how long each command ran. Nothing is allocated while counting so the
+ * counters can stay on all the time. They are printed by the 'stats' builtin
+ * and to stderr when the shell exits if given '--stats-on-exit'.
+ */
+
+#ifndef CS352P1_STATS_H
+#define CS352P1_STATS_H
+
+#include "shellVariables.h"
+#include <stdint.h>
+#include <stdio.h>
+
+/* A histogram of times in microseconds. Every power of two is split into
+ * 2^STATS_SUB_BITS buckets, so a bucket is never wider than 1/2^STATS_SUB_BITS
+ * of the times it holds, the same layout as an HDR histogram. */
+typedef struct Histogram {
+    uint64_t count;
+    uint64_t total;
+    uint64_t max;
+    uint64_t buckets[STATS_BUCKETS];
+} Histogram;
+
+/* Every counter kept by the shell. */
+typedef struct Stats {
+    /* Lines that ran a command. */
+    uint64_t commands;
+    /* Copies of the shell made to run builtins in a pipeline or the background. */
+    uint64_t forks;
+    /* Programs started with posix_spawn. */
+    uint64_t execs;
+    /* Stages that could not be started, which are given the exit status 127, 126 or 1. */
+    uint64_t execFailures;
+    uint64_t pipes;
+    /* Bytes of background output replayed from memory files or streamed. */
+    uint64_t capturedBytes;
+    /* Children that exited and background jobs that were reported. */
+    uint64_t reaped;
+    uint64_t jobsDone;
+    /* Lines found in the parse cache, lines parsed and lines forgotten to make room. */
+    uint64_t parseHits;
+    uint64_t parseMisses;
+    uint64_t parseEvictions;
+    /* Directories matched against from the glob cache and directories read. */
+    uint64_t globHits;
+    uint64_t globReads;
+    /* The time taken to start each stage and the wall time of each command. */
+    Histogram launchTime;
+    Histogram commandTime;
+} Stats;
+
+extern Stats stats;
+
+/* Returns the monotonic clock in nanoseconds. */
+uint64_t statsClock();
+
+/* Adds a time given in nanoseconds to a histogram. */
+void recordLatency(Histogram* histogram, uint64_t nanoseconds);
+
+/* Returns the upper bound in microseconds of the bucket holding the given
+ * fraction of the times of a histogram, or 0 if it is empty. */
+uint64_t histogramPercentile(const Histogram* histogram, double fraction);
+
+/* Prints every counter to out as 'name value' lines. */
+void printStats(FILE* out);
+
+/* Prints the counters to stderr, registered with atexit by '--stats-on-exit'. */
+void printExitStats();
+
+/* Prints the counters, or with -r sets them all back to zero. */
+int builtinStats(char** args);
+
+#endif //CS352P1_STATS_H
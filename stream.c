@@ -0,0 +1,163 @@
+/* Benjamin Schroeder
+ *
+ * stream.c
+ *
+ * The implementation of streaming the output of background jobs. When enabled
+ * with 'set -o stream' a background job writes to a pipe instead of a memory
+ * file, and the shell watches every such pipe with epoll. Each complete line
+ * is printed as soon as it arrives, prefixed with the job number, so long
+ * running jobs show their progress and the shell only ever holds one line of
+ * each job's output.
+ */
+
+#define _GNU_SOURCE
+
+#include "stream.h"
+#include "stats.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+
+int streamEnabled = 0;
+
+// The epoll instance watching every stream, created on first use
+int streamEpoll = -1;
+
+// How many streams are being watched
+int streamCount = 0;
+
+/* Creates the pipe a streaming job writes to, storing the read end.
+ * Returns the write end or -1 if the pipe could not be created. */
+int openStream(int* readEnd) {
+    int ends[2];
+
+    if (pipe2(ends, O_CLOEXEC) == -1)
+        return -1;
+
+    // The shell never waits on a single stream
+    fcntl(ends[0], F_SETFL, O_NONBLOCK);
+
+    *readEnd = ends[0];
+    return ends[1];
+}
+
+/* Starts watching the read end of a pipe, labelling its lines with
+ * the given job number. */
+Stream* watchStream(int fd, int number) {
+    if (streamEpoll == -1)
+        streamEpoll = epoll_create1(EPOLL_CLOEXEC);
+
+    Stream* stream = (Stream*) calloc(1, sizeof(Stream));
+    stream->fd = fd;
+    stream->number = number;
+
+    struct epoll_event event = {0};
+    event.events = EPOLLIN;
+    event.data.ptr = stream;
+    epoll_ctl(streamEpoll, EPOLL_CTL_ADD, fd, &event);
+    streamCount++;
+
+    return stream;
+}
+
+/* Prints every complete line held by a stream, along with the partial
+ * line if the buffer is full or final is set. Returns the lines printed. */
+int printLines(Stream* stream, int final) {
+    int printed = 0;
+    int start = 0;
+
+    for (int i = 0; i < stream->used; i++) {
+        if (stream->line[i] == '\n') {
+            printf("[%d] %.*s\n", stream->number, i - start, stream->line + start);
+            start = i + 1;
+            printed++;
+        }
+    }
+
+    // A line longer than the buffer is printed in pieces to keep memory bounded
+    if (start < stream->used && (final || (start == 0 && stream->used == STREAM_LINE_SIZE))) {
+        printf("[%d] %.*s\n", stream->number, stream->used - start, stream->line + start);
+        start = stream->used;
+        printed++;
+    }
+
+    // Moves the partial line to the front of the buffer
+    memmove(stream->line, stream->line + start, stream->used - start);
+    stream->used -= start;
+
+    return printed;
+}
+
+/* Reads what a stream has waiting into its buffer once.
+ * Returns the bytes read, 0 at the end of the stream or -1 if none are waiting. */
+ssize_t readStream(Stream* stream) {
+    ssize_t length = read(stream->fd, stream->line + stream->used, STREAM_LINE_SIZE - stream->used);
+
+    if (length > 0) {
+        stream->used += length;
+        stats.capturedBytes += length;
+    }
+    else if (length == -1 && errno != EAGAIN && errno != EINTR)
+        length = 0;
+
+    return length;
+}
+
+/* Prints the complete lines of every stream with output waiting, without
+ * blocking. Returns the number of lines printed. */
+int drainStreams() {
+    if (streamCount == 0)
+        return 0;
+
+    struct epoll_event events[16];
+    int printed = 0;
+    int ready = epoll_wait(streamEpoll, events, 16, 0);
+
+    for (int i = 0; i < ready; i++) {
+        Stream* stream = (Stream*) events[i].data.ptr;
+
+        // The end of the stream is left for closeStream once the job is reported
+        ssize_t length = readStream(stream);
+        if (length > 0)
+            printed += printLines(stream, 0);
+        else if (length == 0)
+            epoll_ctl(streamEpoll, EPOLL_CTL_DEL, stream->fd, NULL);
+    }
+
+    fflush(stdout);
+    return printed;
+}
+
+/* Prints whatever is left in a stream, including a final line without a
+ * newline, then stops watching it and closes it. */
+void closeStream(Stream* stream) {
+    // Reads until the pipe is empty, a process left running may still hold it open
+    while (readStream(stream) > 0)
+        printLines(stream, 0);
+    printLines(stream, 1);
+    fflush(stdout);
+
+    epoll_ctl(streamEpoll, EPOLL_CTL_DEL, stream->fd, NULL);
+    close(stream->fd);
+    free(stream);
+    streamCount--;
+}
+
+/* Returns the epoll descriptor that becomes readable when any stream has
+ * output waiting, or -1 if no stream is being watched. */
+int streamPollFd() {
+    return streamCount > 0 ? streamEpoll : -1;
+}
+
+/* Stops watching every stream without reading them, used by a copy of the
+ * shell as the streams belong to the original. */
+void forgetStreams() {
+    if (streamEpoll != -1)
+        close(streamEpoll);
+    streamEpoll = -1;
+    streamCount = 0;
+}
@@ -0,0 +1,56 @@
+/* Benjamin Schroeder
+ *
+ * stream.h
+ *
+ * The header file for streaming the output of background jobs. When enabled
+ * with 'set -o stream' a background job writes to a pipe instead of a memory
+ * file, and the shell watches every such pipe with epoll. Each complete line
+ * is printed as soon as it arrives, prefixed with the job number, so long
+ * running jobs show their progress and the shell only ever holds one line of
+ * each job's output.
+ */
+
+#ifndef CS352P1_STREAM_H
+#define CS352P1_STREAM_H
+
+#include "shellVariables.h"
+
+/* The read end of a streaming job's pipe along with its partial line. */
+typedef struct Stream {
+    /* The read end of the pipe. */
+    int fd;
+    /* The job number printed before each line. */
+    int number;
+    /* The part of a line that has been read without its newline. */
+    char line[STREAM_LINE_SIZE];
+    int used;
+} Stream;
+
+/* Set by 'set -o stream' to stream the output of background jobs. */
+extern int streamEnabled;
+
+/* Creates the pipe a streaming job writes to, storing the read end.
+ * Returns the write end or -1 if the pipe could not be created. */
+int openStream(int* readEnd);
+
+/* Starts watching the read end of a pipe, labelling its lines with
+ * the given job number. */
+Stream* watchStream(int fd, int number);
+
+/* Prints the complete lines of every stream with output waiting, without
+ * blocking. Returns the number of lines printed. */
+int drainStreams();
+
+/* Prints whatever is left in a stream, including a final line without a
+ * newline, then stops watching it and closes it. */
+void closeStream(Stream* stream);
+
+/* Returns the epoll descriptor that becomes readable when any stream has
+ * output waiting, or -1 if no stream is being watched. */
+int streamPollFd();
+
+/* Stops watching every stream without reading them, used by a copy of the
+ * shell as the streams belong to the original. */
+void forgetStreams();
+
+#endif //CS352P1_STREAM_H
@@ -0,0 +1,166 @@
+/* Benjamin Schroeder
+ *
+ * substitute.c
+ *
+ * The implementation of command substitution, the running of the command
+ * inside $(...) or `...` so its output can take the place of the words
+ * that named it. The command is run by a copy of the shell, so it can be
+ * any list, loop or builtin and cannot change the variables or directory of
+ * the shell, with its output going to a pipe. The shell reads the pipe in
+ * large chunks straight into the arena of the command being expanded, so
+ * nothing is written to a file and the output is only copied if it outgrows
+ * the space set aside for it.
+ */
+
+#define _GNU_SOURCE
+
+#include "substitute.h"
+#include "Cmd.h"
+#include "processList.h"
+#include "builtins.h"
+#include "stream.h"
+#include "trace.h"
+#include "zygote.h"
+#include "stats.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+/* Runs the length bytes of text in the copy of the shell and returns its
+ * exit status, set by the shell to the function it runs -c text with. A
+ * substitution expands to nothing while it is not set. */
+int (*substitutionRunner)(const char* text, size_t length) = NULL;
+
+// Waits for the copy of the shell, kept between substitutions unless it is stopped and handed to the process list
+Cmd* substitution = NULL;
+
+/* Runs the length bytes of text in a copy of the shell writing to output.
+ * Returns the pid of the copy or -1 if it could not be forked. */
+pid_t forkSubstitution(const char* text, size_t length, int input, int output) {
+    // Anything left in the buffer would otherwise be printed by both
+    fflush(stdout);
+
+    pid_t pid = fork();
+    if (pid != 0)
+        return pid;
+
+    // The copy runs the text as the shell would, without the jobs of the shell
+    subshell = 1;
+    signal(SIGTSTP, SIG_DFL);
+    forgetProcesses();
+    forgetStreams();
+    forgetTrace();
+    forgetZygote();
+
+    close(input);
+    dup2(output, STDOUT_FILENO);
+    close(output);
+
+    int status = substitutionRunner(text, length);
+    fflush(stdout);
+    _exit(status);
+}
+
+/* Waits in the foreground for the copy of the shell with the given pid,
+ * running the length bytes of text. Returns its exit status. */
+int waitSubstitution(pid_t pid, const char* text, size_t length) {
+    if (substitution == NULL)
+        substitution = newCmd();
+    Cmd* cmd = substitution;
+
+    // The copy is waited on as a command of one stage so it is reaped and stopped like any other
+    cmd->line = arenaCopy(&cmd->arena, text, length);
+    cmd->pipeline = (Pipeline*) arenaAlloc(&cmd->arena, sizeof(Pipeline));
+    memset(cmd->pipeline, 0, sizeof(Pipeline));
+    cmd->pids = (pid_t*) arenaAlloc(&cmd->arena, sizeof(pid_t));
+    cmd->pidfds = (int*) arenaAlloc(&cmd->arena, sizeof(int));
+    cmd->statuses = (int*) arenaAlloc(&cmd->arena, sizeof(int));
+    cmd->usages = (struct rusage*) arenaAlloc(&cmd->arena, sizeof(struct rusage));
+    cmd->finished = (struct timespec*) arenaAlloc(&cmd->arena, sizeof(struct timespec));
+    memset(cmd->usages, 0, sizeof(struct rusage));
+    clock_gettime(CLOCK_MONOTONIC, &cmd->started);
+    cmd->pids[0] = pid;
+    cmd->pidfds[0] = -1;
+    cmd->statuses[0] = -1;
+    cmd->stageCount = 1;
+    cmd->pid = pid;
+
+    int wait = waitForeground(cmd);
+    if (wait == -2) {
+        substitution = NULL;
+        return 128 + SIGTSTP;
+    }
+
+    resetCmd(cmd);
+    return exitCode(wait);
+}
+
+/* Runs the length bytes of text in a copy of the shell with its output
+ * going to a pipe, and reads everything written to the pipe into arena.
+ * Null bytes and the newlines at the end of the output are removed. The
+ * exit status of the command is stored in status and the length of the
+ * output in outputLength. Returns the null terminated output. */
+char* substituteCommand(const char* text, size_t length, size_t* outputLength, int* status, Arena* arena) {
+    int pipes[2];
+    pid_t pid = -1;
+
+    if (substitutionRunner != NULL && pipe2(pipes, O_CLOEXEC) == 0) {
+        // A larger pipe lets a command writing a lot hand it over in fewer, larger reads
+        fcntl(pipes[1], F_SETPIPE_SZ, SUBSTITUTE_PIPE_SIZE);
+        pid = forkSubstitution(text, length, pipes[0], pipes[1]);
+        stats.pipes++;
+        stats.forks++;
+        close(pipes[1]);
+        if (pid == -1)
+            close(pipes[0]);
+    }
+
+    if (pid == -1) {
+        *outputLength = 0;
+        *status = 1;
+        return arenaCopy(arena, "", 0);
+    }
+
+    // The output is read into the arena, moved to a block twice the size whenever it fills the one it is in
+    size_t capacity = SUBSTITUTE_READ_SIZE;
+    size_t used = 0;
+    char* output = (char*) arenaAlloc(arena, capacity);
+
+    for (;;) {
+        if (used + 1 == capacity) {
+            output = (char*) arenaResize(arena, output, used, capacity * 2);
+            capacity *= 2;
+        }
+
+        ssize_t count = read(pipes[0], output + used, capacity - used - 1);
+        if (count == -1 && errno == EINTR)
+            continue;
+        if (count <= 0)
+            break;
+        used += count;
+    }
+    close(pipes[0]);
+
+    *status = waitSubstitution(pid, text, length);
+
+    // Null bytes cannot be held by a word, so they are dropped
+    if (memchr(output, '\0', used) != NULL) {
+        size_t kept = 0;
+        for (size_t i = 0; i < used; i++) {
+            if (output[i] != '\0')
+                output[kept++] = output[i];
+        }
+        used = kept;
+    }
+
+    while (used > 0 && output[used - 1] == '\n')
+        used--;
+    output[used] = '\0';
+
+    // The space that was not needed goes back to the arena
+    *outputLength = used;
+    return (char*) arenaResize(arena, output, used, used + 1);
+}
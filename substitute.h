@@ -0,0 +1,34 @@
+/* Benjamin Schroeder
+ *
+ * substitute.h
+ *
+ * The header file for command substitution, the running of the command
+ * inside $(...) or `...` so its output can take the place of the words
+ * that named it. The command is run by a copy of the shell, so it can be
+ * any list, loop or builtin and cannot change the variables or directory of
+ * the shell, with its output going to a pipe. The shell reads the pipe in
+ * large chunks straight into the arena of the command being expanded, so
+ * nothing is written to a file and the output is only copied if it outgrows
+ * the space set aside for it.
+ */
+
+#ifndef CS352P1_SUBSTITUTE_H
+#define CS352P1_SUBSTITUTE_H
+
+#include "shellVariables.h"
+#include "arena.h"
+#include <stddef.h>
+
+/* Runs the length bytes of text in the copy of the shell and returns its
+ * exit status, set by the shell to the function it runs -c text with. A
+ * substitution expands to nothing while it is not set. */
+extern int (*substitutionRunner)(const char* text, size_t length);
+
+/* Runs the length bytes of text in a copy of the shell with its output
+ * going to a pipe, and reads everything written to the pipe into arena.
+ * Null bytes and the newlines at the end of the output are removed. The
+ * exit status of the command is stored in status and the length of the
+ * output in outputLength. Returns the null terminated output. */
+char* substituteCommand(const char* text, size_t length, size_t* outputLength, int* status, Arena* arena);
+
+#endif //CS352P1_SUBSTITUTE_H
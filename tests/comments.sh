@@ -0,0 +1,9 @@
+#!/usr/bin/env shell352
+# a comment line
+echo a # b
+echo c#d "#e" \#f
+   # indented
+for i in 1 2; do # loop
+  echo $i # body
+done
+echo done
@@ -0,0 +1,8 @@
+nosuchcmd_x
+echo $?
+cat < /nonexistent/in
+echo $?
+echo a | cat > /nonexistent/out
+echo $?
+/bin/true >&9
+echo $?
@@ -0,0 +1,8 @@
+i=0
+while test $i = 0; do i=1; false; done
+echo $?
+while false; do true; done
+echo $?
+i=0
+until test $i = 1; do i=1; false; done
+echo $?
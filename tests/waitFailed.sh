@@ -0,0 +1,3 @@
+nosuchcmd_x &
+wait
+echo waited $?
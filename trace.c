@@ -0,0 +1,147 @@
+/* Benjamin Schroeder
+ *
+ * trace.c
+ *
+ * The implementation of tracing where the shell spends its time. When enabled
+ * with the SHELL352_TRACE environment variable or 'set -o trace' the shell
+ * timestamps reading, parsing, starting and waiting for commands with the
+ * monotonic clock. Events are kept in a fixed buffer and appended to a file
+ * as Chrome trace events after every line, with the lifetime of each child
+ * recorded under its own pid, so a whole session can be opened in a trace
+ * viewer such as Perfetto or chrome://tracing.
+ */
+
+#include "trace.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+int traceEnabled = 0;
+
+// The file events are appended to, -1 when not tracing
+int traceFile = -1;
+
+// The events recorded since the last flush, filled by the main loop only
+TraceEvent traceEvents[TRACE_BUFFER_SIZE];
+int traceUsed = 0;
+
+// The pid of the shell, looked up once when tracing starts
+pid_t tracePid = 0;
+
+/* Starts tracing to the file at path, which is created if needed and
+ * appended to otherwise. Returns -1 if the file could not be opened. */
+int startTrace(const char* path) {
+    if (traceEnabled)
+        stopTrace();
+
+    traceFile = open(path, O_WRONLY|O_APPEND|O_CREAT|O_CLOEXEC, 0666);
+    if (traceFile == -1) {
+        fprintf(stderr, "trace: %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+
+    // The array is left open so every shell appending to the file adds to the same trace
+    struct stat info;
+    if (fstat(traceFile, &info) == 0 && info.st_size == 0)
+        write(traceFile, "[\n", 2);
+
+    tracePid = getpid();
+    traceUsed = 0;
+    traceEnabled = 1;
+    return 0;
+}
+
+/* Writes any buffered events and stops tracing. */
+void stopTrace() {
+    if (!traceEnabled)
+        return;
+
+    flushTrace();
+    close(traceFile);
+    traceFile = -1;
+    traceEnabled = 0;
+}
+
+/* Converts a time taken from the monotonic clock to nanoseconds. */
+uint64_t traceTime(struct timespec time) {
+    return (uint64_t) time.tv_sec * 1000000000 + time.tv_nsec;
+}
+
+/* Returns the monotonic clock in nanoseconds, or 0 when not tracing so
+ * untraced code does not read the clock. */
+uint64_t traceClock() {
+    if (!traceEnabled)
+        return 0;
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return traceTime(now);
+}
+
+/* Claims the next slot of the buffer, writing the buffer out first when
+ * it is full. */
+TraceEvent* nextTraceEvent() {
+    if (traceUsed == TRACE_BUFFER_SIZE)
+        flushTrace();
+    return &traceEvents[traceUsed++];
+}
+
+/* Records a span of the shell called name from start until now, with an
+ * optional argument. Does nothing when not tracing. */
+void traceSpan(const char* name, uint64_t start, const char* argName, long arg) {
+    if (!traceEnabled)
+        return;
+
+    uint64_t end = traceClock();
+    TraceEvent* event = nextTraceEvent();
+    *event = (TraceEvent) {name, 'X', tracePid, start, end, argName, arg};
+}
+
+/* Records that the child pid started running name at time, or finished if
+ * phase is 'E'. Does nothing when not tracing. */
+void traceChild(const char* name, char phase, pid_t pid, uint64_t time) {
+    if (!traceEnabled)
+        return;
+
+    TraceEvent* event = nextTraceEvent();
+    *event = (TraceEvent) {name, phase, pid, time, time, NULL, 0};
+}
+
+/* Appends every buffered event to the trace file. */
+void flushTrace() {
+    if (!traceEnabled || traceUsed == 0)
+        return;
+
+    // Each event is one line, written together so shells sharing the file do not interleave
+    static char text[TRACE_BUFFER_SIZE * 160];
+    int used = 0;
+
+    for (int i = 0; i < traceUsed; i++) {
+        TraceEvent* event = &traceEvents[i];
+
+        // Chrome traces are in microseconds
+        used += sprintf(text + used, "{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%.3f,\"pid\":%d,\"tid\":%d",
+                        event->name, event->phase, event->start / 1000.0, event->pid, event->pid);
+        if (event->phase == 'X')
+            used += sprintf(text + used, ",\"dur\":%.3f", (event->end - event->start) / 1000.0);
+        if (event->argName != NULL)
+            used += sprintf(text + used, ",\"args\":{\"%s\":%ld}", event->argName, event->arg);
+        used += sprintf(text + used, "},\n");
+    }
+
+    write(traceFile, text, used);
+    traceUsed = 0;
+}
+
+/* Drops the buffered events and stops tracing without writing, used by a
+ * copy of the shell so the events of the shell are not written twice. */
+void forgetTrace() {
+    if (traceFile != -1)
+        close(traceFile);
+    traceFile = -1;
+    traceUsed = 0;
+    traceEnabled = 0;
+}
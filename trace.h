@@ -0,0 +1,70 @@
+/* Benjamin Schroeder
+ *
+ * trace.h
+ *
+ * The header file for tracing where the shell spends its time. When enabled
+ * with the SHELL352_TRACE environment variable or 'set -o trace' the shell
+ * timestamps reading, parsing, starting and waiting for commands with the
+ * monotonic clock. Events are kept in a fixed buffer and appended to a file
+ * as Chrome trace events after every line, with the lifetime of each child
+ * recorded under its own pid, so a whole session can be opened in a trace
+ * viewer such as Perfetto or chrome://tracing.
+ */
+
+#ifndef CS352P1_TRACE_H
+#define CS352P1_TRACE_H
+
+#include "shellVariables.h"
+#include <stdint.h>
+#include <sys/types.h>
+#include <time.h>
+
+/* A traced span, or the beginning or end of a child's lifetime. */
+typedef struct TraceEvent {
+    /* The name shown in the viewer, always a string literal. */
+    const char* name;
+    /* 'X' for a span, 'B' and 'E' for the start and end of a child. */
+    char phase;
+    /* The pid the event is shown under. */
+    pid_t pid;
+    /* The start and end in nanoseconds of the monotonic clock. */
+    uint64_t start;
+    uint64_t end;
+    /* An optional argument shown with the event, skipped when argName is NULL. */
+    const char* argName;
+    long arg;
+} TraceEvent;
+
+/* Set while the shell is tracing. */
+extern int traceEnabled;
+
+/* Starts tracing to the file at path, which is created if needed and
+ * appended to otherwise. Returns -1 if the file could not be opened. */
+int startTrace(const char* path);
+
+/* Writes any buffered events and stops tracing. */
+void stopTrace();
+
+/* Returns the monotonic clock in nanoseconds, or 0 when not tracing so
+ * untraced code does not read the clock. */
+uint64_t traceClock();
+
+/* Converts a time taken from the monotonic clock to nanoseconds. */
+uint64_t traceTime(struct timespec time);
+
+/* Records a span of the shell called name from start until now, with an
+ * optional argument. Does nothing when not tracing. */
+void traceSpan(const char* name, uint64_t start, const char* argName, long arg);
+
+/* Records that the child pid started running name at time, or finished if
+ * phase is 'E'. Does nothing when not tracing. */
+void traceChild(const char* name, char phase, pid_t pid, uint64_t time);
+
+/* Appends every buffered event to the trace file. */
+void flushTrace();
+
+/* Drops the buffered events and stops tracing without writing, used by a
+ * copy of the shell so the events of the shell are not written twice. */
+void forgetTrace();
+
+#endif //CS352P1_TRACE_H
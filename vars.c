@@ -0,0 +1,248 @@
+/* Benjamin Schroeder
+ *
+ * vars.c
+ *
+ * The implementation of the variables of the shell. Every variable, whether
+ * it is only seen by the shell or exported to the commands it runs, is kept
+ * in a single open addressing hash table as one "NAME=VALUE" string, and
+ * the environment of the shell is loaded into it at startup. The envp given
+ * to every command points straight at those strings and is only rebuilt
+ * once a variable is exported or unset, so starting a command never copies
+ * the environment no matter how large it is.
+ */
+
+#include "vars.h"
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// The table of variables, its capacity is always a power of two
+Variable* variables = NULL;
+int variableCapacity = 0;
+// Slots holding a variable or left behind by one that was unset
+int variableUsed = 0;
+
+// The environment given to commands, rebuilt when envStale is set
+char** envp = NULL;
+int envCount = 0;
+int envStale = 1;
+// Counts every change to the environment, including new values swapped in place
+unsigned long environmentGeneration = 1;
+
+/* Returns the 32 bit FNV-1a hash of the length bytes of name. */
+uint32_t hashVariable(const char* name, size_t length) {
+    uint32_t hash = 2166136261U;
+    for (size_t i = 0; i < length; i++) {
+        hash ^= (unsigned char) name[i];
+        hash *= 16777619U;
+    }
+    return hash;
+}
+
+/* Returns the slot holding the variable with the length bytes of name, or
+ * the free slot it would be put in if it is not set. */
+Variable* findSlot(const char* name, size_t length, uint32_t hash) {
+    Variable* reusable = NULL;
+
+    for (int i = hash & (variableCapacity - 1);; i = (i + 1) & (variableCapacity - 1)) {
+        Variable* slot = &variables[i];
+
+        // An unset variable's slot can be reused, but the name may still be further on
+        if (slot->text == NULL) {
+            if (!slot->removed)
+                return reusable != NULL ? reusable : slot;
+            if (reusable == NULL)
+                reusable = slot;
+        } else if (slot->hash == hash && slot->nameLength == length && memcmp(slot->text, name, length) == 0) {
+            return slot;
+        }
+    }
+}
+
+/* Doubles the table, or creates it, dropping the slots of unset variables. */
+void growVariables() {
+    Variable* old = variables;
+    int oldCapacity = variableCapacity;
+
+    variableCapacity = oldCapacity == 0 ? VARIABLE_TABLE_SIZE : oldCapacity * 2;
+    variables = (Variable*) calloc(variableCapacity, sizeof(Variable));
+    variableUsed = 0;
+
+    for (int i = 0; i < oldCapacity; i++) {
+        if (old[i].text == NULL)
+            continue;
+        *findSlot(old[i].text, old[i].nameLength, old[i].hash) = old[i];
+        variableUsed++;
+    }
+    free(old);
+}
+
+/* Stores name=value in the table, returning its slot. When exported is set
+ * the variable is exported, otherwise it keeps the export it had. */
+Variable* storeVariable(const char* name, size_t length, const char* value, int exported) {
+    // The table is kept under three quarters full so probes stay short
+    if ((variableUsed + 1) * 4 > variableCapacity * 3)
+        growVariables();
+
+    uint32_t hash = hashVariable(name, length);
+    Variable* slot = findSlot(name, length, hash);
+
+    // Setting a variable to the value it has changes nothing
+    if (slot->text != NULL && value != NULL && strcmp(slot->text + length + 1, value) == 0) {
+        if (exported && !slot->exported) {
+            slot->exported = 1;
+            envStale = 1;
+            environmentGeneration++;
+        }
+        return slot;
+    }
+
+    // Exporting a variable that is not set gives it an empty value
+    if (value == NULL)
+        value = slot->text != NULL ? slot->text + length + 1 : "";
+
+    size_t valueLength = strlen(value);
+    char* text = (char*) malloc(length + valueLength + 2);
+    memcpy(text, name, length);
+    text[length] = '=';
+    memcpy(text + length + 1, value, valueLength + 1);
+
+    if (slot->text == NULL) {
+        if (!slot->removed)
+            variableUsed++;
+        slot->hash = hash;
+        slot->nameLength = length;
+        slot->exported = 0;
+        slot->removed = 0;
+        slot->envIndex = -1;
+    }
+    free(slot->text);
+    slot->text = text;
+
+    // A new value of a variable already in the envp takes the place of the old one
+    if (exported && !slot->exported) {
+        slot->exported = 1;
+        envStale = 1;
+    } else if (slot->exported && !envStale && slot->envIndex != -1) {
+        envp[slot->envIndex] = text;
+    } else if (slot->exported) {
+        envStale = 1;
+    }
+    if (slot->exported)
+        environmentGeneration++;
+
+    return slot;
+}
+
+/* Loads every variable of env into the table as an exported variable. */
+void importEnvironment(char** env) {
+    for (int i = 0; env[i] != NULL; i++) {
+        char* equals = strchr(env[i], '=');
+        if (equals != NULL && equals != env[i])
+            storeVariable(env[i], equals - env[i], equals + 1, 1);
+    }
+}
+
+/* Returns the length of the name at the start of text, made of a letter or
+ * underscore followed by letters, digits and underscores, or 0 if it does
+ * not start with a name. */
+size_t nameLength(const char* text) {
+    if (text[0] != '_' && !isalpha((unsigned char) text[0]))
+        return 0;
+
+    size_t length = 1;
+    while (text[length] == '_' || isalnum((unsigned char) text[length]))
+        length++;
+    return length;
+}
+
+/* Returns the value of the variable with the length bytes of name, or
+ * NULL if it is not set. */
+const char* findVariable(const char* name, size_t length) {
+    if (variableCapacity == 0)
+        return NULL;
+
+    Variable* slot = findSlot(name, length, hashVariable(name, length));
+    return slot->text != NULL ? slot->text + length + 1 : NULL;
+}
+
+/* Returns the value of the variable name, or NULL if it is not set. */
+const char* getVariable(const char* name) {
+    return findVariable(name, strlen(name));
+}
+
+/* Sets the variable name to value, keeping it exported if it already was. */
+void setVariable(const char* name, const char* value) {
+    storeVariable(name, strlen(name), value, 0);
+}
+
+/* Exports the variable name, setting it to value unless value is NULL. */
+void exportVariable(const char* name, const char* value) {
+    storeVariable(name, strlen(name), value, 1);
+}
+
+/* Removes the variable name if it is set. */
+void unsetVariable(const char* name) {
+    if (variableCapacity == 0)
+        return;
+
+    size_t length = strlen(name);
+    Variable* slot = findSlot(name, length, hashVariable(name, length));
+    if (slot->text == NULL)
+        return;
+
+    if (slot->exported) {
+        envStale = 1;
+        environmentGeneration++;
+    }
+    free(slot->text);
+    slot->text = NULL;
+    slot->removed = 1;
+}
+
+/* Returns 1 if word is an assignment, a name followed by '='. */
+int isAssignment(const char* word) {
+    size_t length = nameLength(word);
+    return length > 0 && word[length] == '=';
+}
+
+/* Returns the NULL terminated environment given to commands, built from
+ * the exported variables the first time it is needed after one is added
+ * or removed. The strings belong to the table and change with it. */
+char** variableEnvironment() {
+    if (!envStale)
+        return envp;
+
+    envCount = 0;
+    for (int i = 0; i < variableCapacity; i++) {
+        if (variables[i].text != NULL && variables[i].exported)
+            envCount++;
+    }
+
+    free(envp);
+    envp = (char**) malloc(sizeof(char*) * (envCount + 1));
+
+    // Each variable remembers where it is so a new value can be swapped in place
+    int used = 0;
+    for (int i = 0; i < variableCapacity; i++) {
+        variables[i].envIndex = -1;
+        if (variables[i].text != NULL && variables[i].exported) {
+            variables[i].envIndex = used;
+            envp[used++] = variables[i].text;
+        }
+    }
+    envp[used] = NULL;
+
+    envStale = 0;
+    return envp;
+}
+
+/* Prints every variable to stdout as NAME=VALUE following prefix, or only
+ * the exported ones if exportedOnly is set. */
+void printVariables(const char* prefix, int exportedOnly) {
+    for (int i = 0; i < variableCapacity; i++) {
+        if (variables[i].text != NULL && (variables[i].exported || !exportedOnly))
+            printf("%s%s\n", prefix, variables[i].text);
+    }
+}
@@ -0,0 +1,75 @@
+/* Benjamin Schroeder
+ *
+ * vars.h
+ *
+ * The header file for the variables of the shell. Every variable, whether
+ * it is only seen by the shell or exported to the commands it runs, is kept
+ * in a single open addressing hash table as one "NAME=VALUE" string, and
+ * the environment of the shell is loaded into it at startup. The envp given
+ * to every command points straight at those strings and is only rebuilt
+ * once a variable is exported or unset, so starting a command never copies
+ * the environment no matter how large it is.
+ */
+
+#ifndef CS352P1_VARS_H
+#define CS352P1_VARS_H
+
+#include "shellVariables.h"
+#include <stddef.h>
+#include <stdint.h>
+
+/* Counts the changes made to the environment, so a copy of it can tell when
+ * it is out of date. */
+extern unsigned long environmentGeneration;
+
+/* A slot of the table of variables. */
+typedef struct Variable {
+    /* The variable as NAME=VALUE, or NULL if the slot is free. */
+    char *text;
+    size_t nameLength;
+    uint32_t hash;
+    /* Set if the variable is given to the commands the shell runs. */
+    char exported;
+    /* Set if the slot held a variable that was unset, so lookups go past it. */
+    char removed;
+    /* Where the variable is in the envp, or -1 if it is not there yet. */
+    int envIndex;
+} Variable;
+
+/* Loads every variable of env into the table as an exported variable. */
+void importEnvironment(char** env);
+
+/* Returns the length of the name at the start of text, made of a letter or
+ * underscore followed by letters, digits and underscores, or 0 if it does
+ * not start with a name. */
+size_t nameLength(const char* text);
+
+/* Returns the value of the variable with the length bytes of name, or
+ * NULL if it is not set. */
+const char* findVariable(const char* name, size_t length);
+
+/* Returns the value of the variable name, or NULL if it is not set. */
+const char* getVariable(const char* name);
+
+/* Sets the variable name to value, keeping it exported if it already was. */
+void setVariable(const char* name, const char* value);
+
+/* Exports the variable name, setting it to value unless value is NULL. */
+void exportVariable(const char* name, const char* value);
+
+/* Removes the variable name if it is set. */
+void unsetVariable(const char* name);
+
+/* Returns 1 if word is an assignment, a name followed by '='. */
+int isAssignment(const char* word);
+
+/* Returns the NULL terminated environment given to commands, built from
+ * the exported variables the first time it is needed after one is added
+ * or removed. The strings belong to the table and change with it. */
+char** variableEnvironment();
+
+/* Prints every variable to stdout as NAME=VALUE following prefix, or only
+ * the exported ones if exportedOnly is set. */
+void printVariables(const char* prefix, int exportedOnly);
+
+#endif //CS352P1_VARS_H
@@ -0,0 +1,391 @@
+/* Benjamin Schroeder
+ *
+ * zygote.c
+ *
+ * The implementation of the zygote launcher. Given '--zygote' the shell forks
+ * a helper as the first thing it does, while it is still as small as it will
+ * ever be. Every command is then sent to the helper over a unix socket, with
+ * its arguments and redirects in one message and its input, output and
+ * working directory passed along with SCM_RIGHTS. The environment is only
+ * sent when it has changed since the last command, and the helper keeps its
+ * own copy of it for the commands after. The helper
+ * starts the command with clone(CLONE_PARENT) so the command is a child of
+ * the shell rather than of the helper, which keeps job control, the reaper
+ * and exit statuses working the same as for commands the shell starts itself.
+ */
+
+#define _GNU_SOURCE
+
+#include "zygote.h"
+#include "vars.h"
+#include "launch.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+
+// The shell's end of the socket, -1 when there is no helper
+int zygoteSocket = -1;
+
+// A request as the helper reads it, shared with the clone that executes it
+typedef struct ZygoteRequest {
+    char* path;
+    char** args;
+    char** env;
+    Redirect* redirects;
+    int redirectCount;
+    int input;
+    int output;
+    int directory;
+    Placement placement;
+    // Set by the clone when it cannot execute the command, with the redirect that failed or -1
+    int error;
+    int failed;
+} ZygoteRequest;
+
+// The counts placed in front of the strings of every request, with the placement of the command,
+// envCount being -1 when the environment is the same as for the last request
+typedef struct ZygoteHeader {
+    int argCount;
+    int envCount;
+    int redirectCount;
+    Placement placement;
+} ZygoteHeader;
+
+// A redirect as it is sent, followed by its file name when it has one
+typedef struct ZygoteRedirect {
+    int action;
+    int fd;
+    int flags;
+    int source;
+    int hasFile;
+} ZygoteRedirect;
+
+// The reply to a request, failed being the redirect that could not be carried out or -1
+typedef struct ZygoteReply {
+    pid_t pid;
+    int error;
+    int failed;
+    int niceError;
+    int cpusError;
+} ZygoteReply;
+
+// Signals the helper ignores so the terminal cannot stop or end it, set back for commands
+int zygoteSignals[] = {SIGINT, SIGQUIT, SIGTSTP, SIGTTIN, SIGTTOU, SIGPIPE};
+
+/* Runs in the clone made for a command, sharing the memory of the helper
+ * until it executes. Moves to the working directory of the shell, applies
+ * the placement of the command, sets up its input and output and carries
+ * out its redirects the same way as the file actions of launch. */
+int zygoteChild(void* argument) {
+    ZygoteRequest* request = (ZygoteRequest*) argument;
+
+    for (int i = 0; i < sizeof(zygoteSignals) / sizeof(int); i++)
+        signal(zygoteSignals[i], SIG_DFL);
+
+    // The clone does not share the working directory of the helper, which never follows cd
+    if (fchdir(request->directory) == -1) {
+        request->error = errno;
+        _exit(127);
+    }
+    applyPlacement(&request->placement);
+
+    dup2(request->input, STDIN_FILENO);
+    dup2(request->output, STDOUT_FILENO);
+
+    const Redirect* failed;
+    if (applyRedirects(request->redirects, request->redirectCount, &failed) == -1) {
+        request->error = errno;
+        request->failed = failed - request->redirects;
+        _exit(127);
+    }
+
+    execve(request->path, request->args, request->env);
+    request->error = errno;
+    _exit(127);
+}
+
+/* Splits count strings starting at text into list, ending it with NULL.
+ * Returns the text after the last string. */
+char* splitStrings(char* text, char** list, int count) {
+    for (int i = 0; i < count; i++) {
+        list[i] = text;
+        text += strlen(text) + 1;
+    }
+    list[count] = NULL;
+    return text;
+}
+
+/* The loop of the helper, which starts one command for every request until
+ * the shell closes its end of the socket. */
+void runZygote(int socket) {
+    for (int i = 0; i < sizeof(zygoteSignals) / sizeof(int); i++)
+        signal(zygoteSignals[i], SIG_IGN);
+
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigprocmask(SIG_SETMASK, &mask, NULL);
+
+    // The clone runs on its own stack until it executes
+    char* stack = mmap(NULL, ZYGOTE_STACK_SIZE, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS|MAP_STACK, -1, 0);
+    if (stack == MAP_FAILED)
+        _exit(1);
+
+    char* buffer = NULL;
+    char** args = NULL;
+    Redirect* redirects = NULL;
+    size_t bufferSize = 0;
+    int argSize = 0;
+    int redirectSize = 0;
+
+    // The environment last sent, copied out of the buffer so it is kept for the requests after
+    char* envText = NULL;
+    char** env = NULL;
+    size_t envTextSize = 0;
+    int envSize = 0;
+
+    while (1) {
+        // The size of the request is found first so any length of arguments fits
+        ssize_t length = recv(socket, NULL, 0, MSG_PEEK|MSG_TRUNC);
+        if (length <= 0)
+            _exit(0);
+        if (length > bufferSize) {
+            bufferSize = length;
+            buffer = realloc(buffer, bufferSize + 1);
+        }
+
+        // The input, output and working directory arrive as three descriptors alongside the request
+        char control[CMSG_SPACE(sizeof(int) * 3)];
+        struct iovec part = {buffer, length};
+        struct msghdr message = {0};
+        message.msg_iov = &part;
+        message.msg_iovlen = 1;
+        message.msg_control = control;
+        message.msg_controllen = sizeof(control);
+
+        if (recvmsg(socket, &message, MSG_CMSG_CLOEXEC) <= 0)
+            _exit(0);
+        struct cmsghdr* header = CMSG_FIRSTHDR(&message);
+        if (header == NULL || header->cmsg_type != SCM_RIGHTS)
+            continue;
+
+        int fds[3];
+        memcpy(fds, CMSG_DATA(header), sizeof(fds));
+
+        // Points the request at the strings inside the buffer
+        ZygoteHeader counts;
+        memcpy(&counts, buffer, sizeof(counts));
+        if (counts.argCount + 1 > argSize) {
+            argSize = counts.argCount + 1;
+            args = realloc(args, sizeof(char*) * argSize);
+        }
+        if (counts.redirectCount > redirectSize) {
+            redirectSize = counts.redirectCount;
+            redirects = realloc(redirects, sizeof(Redirect) * redirectSize);
+        }
+
+        ZygoteRequest request = {0};
+        request.args = args;
+        request.input = fds[0];
+        request.output = fds[1];
+        request.directory = fds[2];
+        request.failed = -1;
+        request.placement = counts.placement;
+
+        char* text = buffer + sizeof(counts);
+        request.path = text;
+        text += strlen(text) + 1;
+        text = splitStrings(text, request.args, counts.argCount);
+
+        // A new environment replaces the copy kept from the requests before
+        if (counts.envCount >= 0) {
+            char* envEnd = text;
+            for (int i = 0; i < counts.envCount; i++)
+                envEnd += strlen(envEnd) + 1;
+            if (envEnd - text > envTextSize) {
+                envTextSize = envEnd - text;
+                envText = realloc(envText, envTextSize);
+            }
+            if (counts.envCount + 1 > envSize) {
+                envSize = counts.envCount + 1;
+                env = realloc(env, sizeof(char*) * envSize);
+            }
+            memcpy(envText, text, envEnd - text);
+            splitStrings(envText, env, counts.envCount);
+            text = envEnd;
+        }
+        request.env = env;
+
+        request.redirects = redirects;
+        request.redirectCount = counts.redirectCount;
+        for (int i = 0; i < counts.redirectCount; i++) {
+            ZygoteRedirect sent;
+            memcpy(&sent, text, sizeof(sent));
+            text += sizeof(sent);
+            redirects[i] = (Redirect) {(char) sent.action, sent.fd, sent.flags, sent.source, sent.hasFile ? text : NULL};
+            if (sent.hasFile)
+                text += strlen(text) + 1;
+        }
+
+        // The clone shares memory and the helper waits until it has executed, the same as posix_spawn
+        ZygoteReply reply;
+        reply.pid = clone(zygoteChild, stack + ZYGOTE_STACK_SIZE,
+                          CLONE_VM|CLONE_VFORK|CLONE_PARENT|SIGCHLD, &request);
+        reply.error = reply.pid == -1 ? errno : request.error;
+        reply.failed = reply.pid == -1 ? -1 : request.failed;
+        reply.niceError = request.placement.niceError;
+        reply.cpusError = request.placement.cpusError;
+
+        // A clone that could not execute still exits as a child of the shell, which ignores it
+        if (reply.error != 0)
+            reply.pid = -1;
+
+        close(fds[0]);
+        close(fds[1]);
+        close(fds[2]);
+        if (send(socket, &reply, sizeof(reply), MSG_NOSIGNAL) == -1)
+            _exit(0);
+    }
+}
+
+/* Starts the helper. Returns -1 if it could not be started, in which case
+ * commands keep being started by the shell. */
+int startZygote() {
+    int ends[2];
+    if (socketpair(AF_UNIX, SOCK_SEQPACKET|SOCK_CLOEXEC, 0, ends) == -1)
+        return -1;
+
+    pid_t pid = fork();
+    if (pid == -1) {
+        close(ends[0]);
+        close(ends[1]);
+        return -1;
+    }
+
+    if (pid == 0) {
+        close(ends[0]);
+        runZygote(ends[1]);
+    }
+
+    close(ends[1]);
+    zygoteSocket = ends[0];
+    return 0;
+}
+
+/* Returns 1 while the helper is running and usable by this process. */
+int zygoteRunning() {
+    return zygoteSocket != -1;
+}
+
+/* Adds length bytes of text to the request being built, growing it as needed. */
+void addToRequest(char** request, size_t* used, size_t* capacity, const char* text, size_t length) {
+    if (*used + length > *capacity) {
+        while (*used + length > *capacity)
+            *capacity = *capacity == 0 ? 4096 : *capacity * 2;
+        *request = realloc(*request, *capacity);
+    }
+    memcpy(*request + *used, text, length);
+    *used += length;
+}
+
+/* Has the helper start the program at path with args as its arguments and
+ * the environment of the shell, set up the same as launch. The pid of the
+ * command, or -1 with errno set if it could not be executed, is stored in pid,
+ * along with the redirect that could not be carried out in failed.
+ * Returns -1 without starting anything if the helper cannot be reached. */
+int zygoteLaunch(const char* path, char** args, int input, int output, const Redirect* redirects, int count, pid_t* pid, const Redirect** failed) {
+    if (zygoteSocket == -1)
+        return -1;
+
+    // The request is kept between commands so it is only grown, never freed
+    static char* request = NULL;
+    static size_t capacity = 0;
+    size_t used = 0;
+    // The generation of the environment the helper holds, 0 before any is sent
+    static unsigned long sentGeneration = 0;
+
+    char** env = NULL;
+    ZygoteHeader counts = {0, -1, count, placement};
+    while (args[counts.argCount] != NULL)
+        counts.argCount++;
+    if (sentGeneration != environmentGeneration) {
+        env = variableEnvironment();
+        counts.envCount = 0;
+        while (env[counts.envCount] != NULL)
+            counts.envCount++;
+    }
+
+    addToRequest(&request, &used, &capacity, (char*) &counts, sizeof(counts));
+    addToRequest(&request, &used, &capacity, path, strlen(path) + 1);
+    for (int i = 0; i < counts.argCount; i++)
+        addToRequest(&request, &used, &capacity, args[i], strlen(args[i]) + 1);
+    for (int i = 0; i < counts.envCount; i++)
+        addToRequest(&request, &used, &capacity, env[i], strlen(env[i]) + 1);
+    for (int i = 0; i < count; i++) {
+        const Redirect* redirect = &redirects[i];
+        ZygoteRedirect sent = {redirect->action, redirect->fd, redirect->flags, redirect->source, redirect->file != NULL};
+        addToRequest(&request, &used, &capacity, (char*) &sent, sizeof(sent));
+        if (redirect->file != NULL)
+            addToRequest(&request, &used, &capacity, redirect->file, strlen(redirect->file) + 1);
+    }
+
+    // The working directory is sent with every command so the helper follows cd
+    int directory = open(".", O_PATH|O_DIRECTORY|O_CLOEXEC);
+    if (directory == -1)
+        return -1;
+
+    // The input, output and working directory go along with the request
+    int fds[3] = {input, output, directory};
+    char control[CMSG_SPACE(sizeof(fds))];
+    memset(control, 0, sizeof(control));
+    struct iovec part = {request, used};
+    struct msghdr message = {0};
+    message.msg_iov = &part;
+    message.msg_iovlen = 1;
+    message.msg_control = control;
+    message.msg_controllen = sizeof(control);
+
+    struct cmsghdr* header = CMSG_FIRSTHDR(&message);
+    header->cmsg_level = SOL_SOCKET;
+    header->cmsg_type = SCM_RIGHTS;
+    header->cmsg_len = CMSG_LEN(sizeof(fds));
+    memcpy(CMSG_DATA(header), fds, sizeof(fds));
+
+    // A helper that went away is given up on and the shell starts commands itself
+    ZygoteReply reply;
+    int sent = sendmsg(zygoteSocket, &message, MSG_NOSIGNAL) != -1
+               && recv(zygoteSocket, &reply, sizeof(reply), 0) == sizeof(reply);
+    close(directory);
+    if (!sent) {
+        close(zygoteSocket);
+        zygoteSocket = -1;
+        return -1;
+    }
+    sentGeneration = environmentGeneration;
+
+    // The errors of the placement are kept the same as for a command the shell starts
+    if (reply.niceError != 0)
+        placement.niceError = reply.niceError;
+    if (reply.cpusError != 0)
+        placement.cpusError = reply.cpusError;
+
+    *pid = reply.pid;
+    if (reply.pid == -1) {
+        *failed = reply.failed == -1 ? NULL : &redirects[reply.failed];
+        errno = reply.error;
+    }
+    return 0;
+}
+
+/* Stops using the helper without telling it, used by a copy of the shell so
+ * only the shell itself talks to the helper. */
+void forgetZygote() {
+    if (zygoteSocket != -1)
+        close(zygoteSocket);
+    zygoteSocket = -1;
+}
@@ -0,0 +1,42 @@
+/* Benjamin Schroeder
+ *
+ * zygote.h
+ *
+ * The header file for the zygote launcher. Given '--zygote' the shell forks
+ * a helper as the first thing it does, while it is still as small as it will
+ * ever be. Every command is then sent to the helper over a unix socket, with
+ * its arguments and redirects in one message and its input, output and
+ * working directory passed along with SCM_RIGHTS. The environment is only
+ * sent when it has changed since the last command, and the helper keeps its
+ * own copy of it for the commands after. The helper
+ * starts the command with clone(CLONE_PARENT) so the command is a child of
+ * the shell rather than of the helper, which keeps job control, the reaper
+ * and exit statuses working the same as for commands the shell starts itself.
+ */
+
+#ifndef CS352P1_ZYGOTE_H
+#define CS352P1_ZYGOTE_H
+
+#include "shellVariables.h"
+#include "parser.h"
+#include <sys/types.h>
+
+/* Starts the helper. Returns -1 if it could not be started, in which case
+ * commands keep being started by the shell. */
+int startZygote();
+
+/* Returns 1 while the helper is running and usable by this process. */
+int zygoteRunning();
+
+/* Has the helper start the program at path with args as its arguments and
+ * the environment of the shell, set up the same as launch. The pid of the
+ * command, or -1 with errno set if it could not be executed, is stored in pid,
+ * along with the redirect that could not be carried out in failed.
+ * Returns -1 without starting anything if the helper cannot be reached. */
+int zygoteLaunch(const char* path, char** args, int input, int output, const Redirect* redirects, int count, pid_t* pid, const Redirect** failed);
+
+/* Stops using the helper without telling it, used by a copy of the shell so
+ * only the shell itself talks to the helper. */
+void forgetZygote();
+
+#endif //CS352P1_ZYGOTE_H